@@ -7,6 +7,74 @@
 using namespace Rcpp;
 using namespace std;
 
+// Native objective functions are evaluated on plain arrays without calling
+// back into R. They can be used from other packages by wrapping a Native in
+// an external pointer with class "tao_native", whose finalizer calls destroy
+// on data and deletes the Native.
+typedef PetscErrorCode (*NativeObjective)(int k, const PetscReal *x, PetscReal *f, void *data);
+typedef PetscErrorCode (*NativeVector)(int k, const PetscReal *x, int n, PetscReal *y, void *data);
+typedef PetscErrorCode (*NativeObjectiveGradient)(int k, const PetscReal *x, PetscReal *f, PetscReal *g, void *data);
+
+typedef struct {
+  NativeObjective objfun;     // f(x)
+  NativeVector grafun;        // gradient, n = k (optional)
+  NativeVector hesfun;        // Hessian in column-major order, n = k * k (optional)
+  NativeVector sepfun;        // separable objective for Pounders (optional)
+  int n;                      // number of elements of sepfun
+  void *data;                 // passed to all functions
+  void (*destroy)(void *data);
+  NativeObjectiveGradient objgrad;  // f(x) and its gradient in one pass (optional)
+  int moments;                // 1 if sepfun are moment conditions, not independent residuals
+} Native;
+
+// Objectives that are sums of terms over the rows of a dataset are described
+// by kernels that add the terms of the rows from begin to end to f and, unless
+// it is NULL, their gradient to g, or their Hessian to h (k x k, column-major).
+// The kernels are called concurrently on disjoint rows from several threads,
+// each with its own f, g and h, and must not call R or PETSc. A NativeSum is
+// turned into a Native objective with tao_sum(), which takes an external
+// pointer of class "tao_sum" to it.
+typedef int (*NativeTerms)(int k, const PetscReal *x, long begin, long end, PetscReal *f, PetscReal *g, void *data);
+typedef int (*NativeTermsHessian)(int k, const PetscReal *x, long begin, long end, PetscReal *h, void *data);
+
+typedef struct {
+  NativeTerms terms;          // f and its gradient
+  NativeTermsHessian hesterms; // Hessian (optional)
+  long rows;                  // number of rows
+  int k;                      // number of parameters
+  void *data;                 // passed to all kernels
+  void (*destroy)(void *data);
+} NativeSum;
+
+// Simulated method of moments and indirect inference: a simulator computes
+// the moments of one simulated dataset from the parameters and the draws of
+// one replication. The draws are generated once and reused at every x, so the
+// simulated moments are smooth in x. The simulator is called concurrently for
+// different replications from several threads, each with its own draws and
+// moments, and must not call R or PETSc. A NativeSimulator is turned into a
+// Native objective with tao_smm(), which takes an external pointer of class
+// "tao_simulator" to it.
+typedef int (*NativeSimulate)(int k, const PetscReal *x, const PetscReal *draws, int m, PetscReal *moments, void *data);
+
+typedef struct {
+  NativeSimulate simulate;    // the moments of one replication
+  long draws;                 // number of draws per replication
+  int moments;                // number of moments
+  int k;                      // number of parameters, 0 if any
+  void *data;                 // passed to simulate
+  void (*destroy)(void *data);
+} NativeSimulator;
+
+struct Checkpoint;
+struct Progress;
+struct Budget;
+struct History;
+struct Latency;
+struct Trace;
+struct Replay;
+struct Minibatch;
+struct Covariance;
+
 // problem structure
 typedef struct {
   Function *objfun;
@@ -14,8 +82,19 @@ typedef struct {
   Function *hesfun;
   Function *inequal;
   Function *equal;
+  Native *native;
   int k;
   int n;
+  bool quiet;
+  Checkpoint *checkpoint;
+  Progress *progress;
+  Budget *budget;
+  History *history;
+  Latency *latency;
+  Trace *trace;
+  Replay *replay;
+  Minibatch *minibatch;
+  Covariance *covariance;
 } Problem;
 
 #define catch_error(operation) do { PetscErrorCode error_code = operation; CHKERRQ(error_code); } while (0)
@@ -6,9 +6,188 @@
 
 using namespace Rcpp;
 
+// tao_async_cpp
+SEXP tao_async_cpp(List functions, NumericVector start_values, String method, List options, int n, NumericVector lower_bounds, NumericVector upper_bounds, List settings);
+RcppExport SEXP taoR_tao_async_cpp(SEXP functionsSEXP, SEXP start_valuesSEXP, SEXP methodSEXP, SEXP optionsSEXP, SEXP nSEXP, SEXP lower_boundsSEXP, SEXP upper_boundsSEXP, SEXP settingsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type functions(functionsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type start_values(start_valuesSEXP);
+    Rcpp::traits::input_parameter< String >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< List >::type options(optionsSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lower_bounds(lower_boundsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type upper_bounds(upper_boundsSEXP);
+    Rcpp::traits::input_parameter< List >::type settings(settingsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_async_cpp(functions, start_values, method, options, n, lower_bounds, upper_bounds, settings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_async_poll_cpp
+List tao_async_poll_cpp(SEXP handle, int k);
+RcppExport SEXP taoR_tao_async_poll_cpp(SEXP handleSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_async_poll_cpp(handle, k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_async_cancel_cpp
+bool tao_async_cancel_cpp(SEXP handle, int k);
+RcppExport SEXP taoR_tao_async_cancel_cpp(SEXP handleSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_async_cancel_cpp(handle, k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_async_wait_cpp
+List tao_async_wait_cpp(SEXP handle);
+RcppExport SEXP taoR_tao_async_wait_cpp(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_async_wait_cpp(handle));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_bench_bridge_cpp
+NumericVector tao_bench_bridge_cpp(List functions, String callback, NumericVector x, int n, int repetitions);
+RcppExport SEXP taoR_tao_bench_bridge_cpp(SEXP functionsSEXP, SEXP callbackSEXP, SEXP xSEXP, SEXP nSEXP, SEXP repetitionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type functions(functionsSEXP);
+    Rcpp::traits::input_parameter< String >::type callback(callbackSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< int >::type repetitions(repetitionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_bench_bridge_cpp(functions, callback, x, n, repetitions));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_dataset_write_cpp
+void tao_dataset_write_cpp(String path, List columns);
+RcppExport SEXP taoR_tao_dataset_write_cpp(SEXP pathSEXP, SEXP columnsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< String >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< List >::type columns(columnsSEXP);
+    tao_dataset_write_cpp(path, columns);
+    return R_NilValue;
+END_RCPP
+}
+// tao_dataset_open_cpp
+SEXP tao_dataset_open_cpp(String path);
+RcppExport SEXP taoR_tao_dataset_open_cpp(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< String >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_dataset_open_cpp(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_dataset_info_cpp
+List tao_dataset_info_cpp(SEXP dataset);
+RcppExport SEXP taoR_tao_dataset_info_cpp(SEXP datasetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type dataset(datasetSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_dataset_info_cpp(dataset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_model_cpp
+SEXP tao_model_cpp(String name, List data);
+RcppExport SEXP taoR_tao_model_cpp(SEXP nameSEXP, SEXP dataSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< String >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< List >::type data(dataSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_model_cpp(name, data));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_native_info_cpp
+List tao_native_info_cpp(SEXP native);
+RcppExport SEXP taoR_tao_native_info_cpp(SEXP nativeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type native(nativeSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_native_info_cpp(native));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_native_gradient_cpp
+NumericVector tao_native_gradient_cpp(SEXP native, NumericVector x);
+RcppExport SEXP taoR_tao_native_gradient_cpp(SEXP nativeSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type native(nativeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_native_gradient_cpp(native, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_profile_cpp
+List tao_profile_cpp(List functions, NumericVector start_values, String method, List options, int n, NumericVector lower_bounds, NumericVector upper_bounds, int index, NumericVector grid);
+RcppExport SEXP taoR_tao_profile_cpp(SEXP functionsSEXP, SEXP start_valuesSEXP, SEXP methodSEXP, SEXP optionsSEXP, SEXP nSEXP, SEXP lower_boundsSEXP, SEXP upper_boundsSEXP, SEXP indexSEXP, SEXP gridSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type functions(functionsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type start_values(start_valuesSEXP);
+    Rcpp::traits::input_parameter< String >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< List >::type options(optionsSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lower_bounds(lower_boundsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type upper_bounds(upper_boundsSEXP);
+    Rcpp::traits::input_parameter< int >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type grid(gridSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_profile_cpp(functions, start_values, method, options, n, lower_bounds, upper_bounds, index, grid));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_smm_cpp
+SEXP tao_smm_cpp(SEXP simulator, List settings);
+RcppExport SEXP taoR_tao_smm_cpp(SEXP simulatorSEXP, SEXP settingsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type simulator(simulatorSEXP);
+    Rcpp::traits::input_parameter< List >::type settings(settingsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_smm_cpp(simulator, settings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_sum_cpp
+SEXP tao_sum_cpp(SEXP terms, int threads);
+RcppExport SEXP taoR_tao_sum_cpp(SEXP termsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_sum_cpp(terms, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // tao_cpp
-List tao_cpp(List functions, NumericVector start_values, String method, List options, int n, NumericVector lower_bounds, NumericVector upper_bounds);
-RcppExport SEXP taoR_tao_cpp(SEXP functionsSEXP, SEXP start_valuesSEXP, SEXP methodSEXP, SEXP optionsSEXP, SEXP nSEXP, SEXP lower_boundsSEXP, SEXP upper_boundsSEXP) {
+List tao_cpp(List functions, NumericVector start_values, String method, List options, int n, NumericVector lower_bounds, NumericVector upper_bounds, List settings);
+RcppExport SEXP taoR_tao_cpp(SEXP functionsSEXP, SEXP start_valuesSEXP, SEXP methodSEXP, SEXP optionsSEXP, SEXP nSEXP, SEXP lower_boundsSEXP, SEXP upper_boundsSEXP, SEXP settingsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -19,7 +198,53 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type n(nSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type lower_bounds(lower_boundsSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type upper_bounds(upper_boundsSEXP);
-    rcpp_result_gen = Rcpp::wrap(tao_cpp(functions, start_values, method, options, n, lower_bounds, upper_bounds));
+    Rcpp::traits::input_parameter< List >::type settings(settingsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_cpp(functions, start_values, method, options, n, lower_bounds, upper_bounds, settings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_trace_open_cpp
+SEXP tao_trace_open_cpp(String path);
+RcppExport SEXP taoR_tao_trace_open_cpp(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< String >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_trace_open_cpp(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_trace_info_cpp
+List tao_trace_info_cpp(SEXP trace);
+RcppExport SEXP taoR_tao_trace_info_cpp(SEXP traceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type trace(traceSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_trace_info_cpp(trace));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_trace_types_cpp
+List tao_trace_types_cpp(SEXP trace);
+RcppExport SEXP taoR_tao_trace_types_cpp(SEXP traceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type trace(traceSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_trace_types_cpp(trace));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tao_trace_read_cpp
+List tao_trace_read_cpp(SEXP trace, IntegerVector records);
+RcppExport SEXP taoR_tao_trace_read_cpp(SEXP traceSEXP, SEXP recordsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type records(recordsSEXP);
+    rcpp_result_gen = Rcpp::wrap(tao_trace_read_cpp(trace, records));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -0,0 +1,192 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "utils.h"
+#include "progress.h"
+#include "solver.h"
+
+// A solve of a native objective that runs on its own thread. PETSc is not
+// thread-safe, so no other solve may start until the thread has finished.
+struct AsyncSolve {
+    Solver *solver;
+    std::thread worker;
+    std::atomic<bool> done;
+};
+
+static std::atomic<int> running_solves(0);
+
+bool async_running() {
+    return running_solves.load() > 0;
+}
+
+static void run_solve(AsyncSolve *async) {
+    async->solver->error = solver_solve(async->solver);
+    async->done = true;
+    running_solves--;
+}
+
+// Cancels and joins a solve that is still running when its handle is
+// garbage collected.
+static void async_finalizer(AsyncSolve *async) {
+    if (async->worker.joinable()) {
+        progress_cancel(async->solver->problem.progress);
+        async->worker.join();
+    }
+    if (async->solver != NULL) {
+        solver_destroy(async->solver);
+    }
+    delete async;
+}
+
+//' Start an asynchronous solve on a background thread
+//'
+//' \code{tao_async_cpp} is an internal function of this package. It is recommended
+//' that users call \code{\link{tao_async}} instead. The arguments are the same as
+//' for \code{\link{tao_cpp}}, but \code{functions} must contain a native objective
+//' function.
+//'
+//' @param functions is a list with a native objective function.
+//' @param start_values is a vector containing the starting values of the parameters.
+//' @param method is a string that determines the type of optimizer to be used.
+//' @param options is a list containing option values for the optimizer
+//' @param n is the number of elements in the objective function.
+//' @param lower_bounds is a vector with lower bounds
+//' @param upper_bounds is a vector with upper bounds
+//' @param settings is a list with settings that are not passed to PETSc.
+//' @return an external pointer to the running solve
+// [[Rcpp::export]]
+SEXP tao_async_cpp(List functions,
+                   NumericVector start_values,
+                   String method,
+                   List options,
+                   int n,
+                   NumericVector lower_bounds,
+                   NumericVector upper_bounds,
+                   List settings) {
+
+    if (!functions.containsElementNamed("native")) {
+        stop("only native objective functions can be solved on a background thread.");
+    }
+
+    Solver *solver;
+    if (solver_create(&solver, functions, start_values, method, options, n,
+                      lower_bounds, upper_bounds, settings) != 0) {
+        stop("cannot set up the solver.");
+    }
+    solver->problem.progress = progress_create(start_values.size());
+
+    AsyncSolve *async = new AsyncSolve();
+    async->solver = solver;
+    async->done = false;
+    running_solves++;
+    async->worker = std::thread(run_solve, async);
+
+    return XPtr<AsyncSolve, PreserveStorage, async_finalizer>(async, true);
+}
+
+//' Poll the progress of an asynchronous solve
+//'
+//' @param handle is an external pointer to a solve on a background thread or the
+//'        path of the progress file of a solve in a child process.
+//' @param k is the number of parameters, or -1 to read it from the progress file.
+//' @return a list with the status, the number of iterations, the function value,
+//'         the gradient norm, the convergence reason and the current iterate
+// [[Rcpp::export]]
+List tao_async_poll_cpp(SEXP handle, int k) {
+
+    if (TYPEOF(handle) == STRSXP) {
+        Progress *progress = progress_map(as<string>(handle), k, PROGRESS_READ);
+        List snapshot = progress_read(progress);
+        progress_close(progress);
+        return snapshot;
+    }
+
+    XPtr<AsyncSolve> async(handle);
+    flush_output();
+    if (async->solver == NULL) {
+        stop("the solve has already been collected.");
+    }
+    return progress_read(async->solver->problem.progress);
+}
+
+//' Request cancellation of an asynchronous solve
+//'
+//' @param handle is an external pointer to a solve on a background thread or the
+//'        path of the progress file of a solve in a child process.
+//' @param k is the number of parameters.
+//' @return whether the cancellation could be requested
+// [[Rcpp::export]]
+bool tao_async_cancel_cpp(SEXP handle, int k) {
+
+    if (TYPEOF(handle) == STRSXP) {
+        Progress *progress = progress_map(as<string>(handle), k, PROGRESS_WRITE);
+        progress_cancel(progress);
+        progress_close(progress);
+        return progress != NULL;
+    }
+
+    XPtr<AsyncSolve> async(handle);
+    if (async->solver == NULL) {
+        return false;
+    }
+    progress_cancel(async->solver->problem.progress);
+    return true;
+}
+
+//' Wait for an asynchronous solve on a background thread to finish
+//'
+//' @param handle is an external pointer to a solve on a background thread.
+//' @return a list with the result of the solve and its final progress
+// [[Rcpp::export]]
+List tao_async_wait_cpp(SEXP handle) {
+
+    XPtr<AsyncSolve> async(handle);
+    if (async->solver == NULL) {
+        stop("the solve has already been collected.");
+    }
+
+    // Keep R responsive to interrupts while waiting
+    while (!async->done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        flush_output();
+        checkUserInterrupt();
+    }
+    async->worker.join();
+    flush_output();
+
+    Solver *solver = async->solver;
+    if (solver->error != 0) {
+        PetscErrorCode error = solver->error;
+        async->solver = NULL;
+        solver_destroy(solver);
+        stop("the solve failed with PETSc error code %d.", error);
+    }
+
+    List progress = progress_read(solver->problem.progress);
+    List result = solver_result(solver);
+    async->solver = NULL;
+    solver_destroy(solver);
+
+    return List::create(
+        Named("result") = result,
+        Named("progress") = progress
+    );
+}
@@ -0,0 +1,133 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <petsctime.h>
+#include "utils.h"
+#include "evaluate.h"
+#include "budget.h"
+#include "latency.h"
+#include "solver.h"
+
+// The TAO context and the vectors the callbacks are evaluated on
+static PetscErrorCode bridge_workspace(const NumericVector &x, int n, bool hessian, Tao *tao_context,
+                                       Vec *X, Vec *G, Vec *F, Mat *H) {
+    int k = x.size();
+    PetscFunctionBegin;
+    catch_error(TaoCreate(PETSC_COMM_SELF, tao_context));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, k, X));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, k, G));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, n, F));
+    catch_error(create_vec(*X, x));
+    if (hessian) {
+        catch_error(MatCreateSeqDense(PETSC_COMM_SELF, k, k, NULL, H));
+    }
+    PetscFunctionReturn(0);
+}
+
+//' Time single evaluations through the bridge between TAO and the objective
+//'
+//' \code{tao_bench_bridge_cpp} is an internal function of this package. It is
+//' recommended that users call \code{\link{tao_bench_bridge}} instead.
+//'
+//' @param functions is a list of functions as for \code{\link{tao_cpp}}, or a
+//'        native objective function.
+//' @param callback is one of \code{"objective"}, \code{"gradient"},
+//'        \code{"hessian"} or \code{"separable"}.
+//' @param x is the vector of parameters to evaluate the callback at.
+//' @param n is the number of elements of the separable objective.
+//' @param repetitions is the number of calls to time.
+//' @return a vector with the time of each call in seconds
+// [[Rcpp::export]]
+NumericVector tao_bench_bridge_cpp(List functions, String callback, NumericVector x, int n, int repetitions) {
+
+    Problem problem = Problem();
+    Tao tao_context = NULL;
+    Vec X = NULL, G = NULL, F = NULL;
+    Mat H = NULL;
+    PetscReal f;
+    PetscLogDouble start, end;
+    PetscErrorCode error_code;
+    string type = callback.get_cstring();
+    int k = x.size();
+
+    // PETSc is not thread-safe, a background solve must not run alongside
+    if (async_running()) {
+        stop("another solve is running in the background, wait for it to finish first.");
+    }
+
+    PetscVFPrintf = print_to_rcout;
+    initialize();
+
+    // The problem context, as set up by solver_create
+    if (functions.containsElementNamed("native")) {
+        XPtr<Native> native(functions["native"]);
+        problem.native = native.get();
+    } else {
+        problem.objfun = new Function(functions["objfun"]);
+        if (functions.containsElementNamed("grafun")) {
+            problem.grafun = new Function(functions["grafun"]);
+        }
+        if (functions.containsElementNamed("hesfun")) {
+            problem.hesfun = new Function(functions["hesfun"]);
+        }
+    }
+    problem.k = k;
+    problem.n = n;
+    problem.quiet = true;
+    problem.budget = budget_create(List::create());
+    problem.latency = latency_create();
+
+    // The workspace is freed below, also if it is incomplete
+    error_code = bridge_workspace(x, n, type == "hessian", &tao_context, &X, &G, &F, &H);
+
+    // Time each call on its own, the caller summarizes the distribution
+    NumericVector times(repetitions);
+    for (int i = 0; i < repetitions && error_code == 0; ++i) {
+        PetscTime(&start);
+        if (type == "objective") {
+            error_code = evaluate_objective(tao_context, X, &f, &problem);
+        } else if (type == "gradient") {
+            error_code = evaluate_gradient(tao_context, X, G, &problem);
+        } else if (type == "hessian") {
+            error_code = evaluate_hessian(tao_context, X, H, H, &problem);
+        } else if (type == "separable") {
+            error_code = evaluate_objective_separable(tao_context, X, F, &problem);
+        } else {
+            error_code = PETSC_ERR_ARG_WRONG;
+        }
+        PetscTime(&end);
+        times[i] = end - start;
+    }
+
+    TaoDestroy(&tao_context);
+    VecDestroy(&X);
+    VecDestroy(&G);
+    VecDestroy(&F);
+    MatDestroy(&H);
+    budget_destroy(problem.budget);
+    latency_destroy(problem.latency);
+    delete problem.objfun;
+    delete problem.grafun;
+    delete problem.hesfun;
+
+    if (error_code != 0) {
+        stop("cannot evaluate the " + type + " callback.");
+    }
+    return times;
+}
@@ -0,0 +1,516 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include "native.h"
+#include "pool.h"
+
+// The inversion of the market shares stops at this change in delta or after
+// this many iterations
+static const PetscReal BLP_TOLERANCE = 1e-12;
+static const int BLP_MAX_ITERATIONS = 2000;
+
+// The GMM objective of the random coefficients logit demand model of Berry,
+// Levinsohn and Pakes (1995). Product j in market t has the mean utility
+// delta_j = X1_j'b + xi_j, and consumer r adds sum_l X2_jl sigma_l nu_rl,
+// with standard normal nu drawn once per market. The mean utilities that
+// match the observed shares are found market by market with the contraction
+// delta <- delta + log(s) - log(s(delta)), accelerated by SQUAREM and
+// started from the solution of the previous evaluation. The moments are
+// g = Z'xi / N with xi = delta - X1 b, and the residuals L^-1 g, where LL' =
+// Z'Z / N, so that their sum of squares is the two-stage least squares GMM
+// objective. The parameters are b followed by sigma. The Jacobian of delta
+// with respect to sigma follows from the implicit function theorem,
+// -(ds/ddelta)^-1 ds/dsigma. The markets are split between threads and their
+// moments are added in the order of the markets.
+struct Blp {
+    int products, k1, k2, instruments, draws;
+    vector<long> market_begin;          // the first product of each market, and the end
+    vector<PetscReal> x1, x2, z, nu;    // row-major, nu per market draws x k2
+    vector<PetscReal> log_shares;
+    vector<PetscReal> cholesky;         // of Z'Z / N, row-major lower triangle
+    vector<PetscReal> zx1;              // dg/db = -Z'X1 / N, instruments x k1
+    vector<PetscReal> delta;            // the last mean utilities
+    bool squarem;
+    ThreadPool *pool;
+    vector<PetscReal> moments, jacobian;  // per market
+    vector<int> error;
+    vector<PetscReal> last_x, last_r, last_dr;
+    bool has_r, has_dr;
+};
+
+// The shares of the products of market t and, unless per_draw is NULL, the
+// shares of each consumer, draws x products
+static void blp_shares(const Blp *model, int t, const PetscReal *sigma, const PetscReal *delta, PetscReal *shares,
+                       PetscReal *per_draw) {
+    long begin = model->market_begin[t];
+    int J = model->market_begin[t + 1] - begin, k2 = model->k2, R = model->draws;
+    const PetscReal *nu = &model->nu[(size_t) t * R * k2];
+    vector<PetscReal> u(J);
+    std::fill(shares, shares + J, 0.0);
+    for (int r = 0; r < R; ++r) {
+        PetscReal largest = 0.0;
+        for (int j = 0; j < J; ++j) {
+            const PetscReal *x2 = &model->x2[(size_t) (begin + j) * k2];
+            PetscReal mu = 0.0;
+            for (int l = 0; l < k2; ++l) {
+                mu += x2[l] * sigma[l] * nu[r * k2 + l];
+            }
+            u[j] = delta[j] + mu;
+            largest = std::max(largest, u[j]);
+        }
+        PetscReal total = exp(-largest);
+        for (int j = 0; j < J; ++j) {
+            u[j] = exp(u[j] - largest);
+            total += u[j];
+        }
+        for (int j = 0; j < J; ++j) {
+            PetscReal s = u[j] / total;
+            shares[j] += s / R;
+            if (per_draw != NULL) {
+                per_draw[(size_t) r * J + j] = s;
+            }
+        }
+    }
+}
+
+// One step of the contraction, returns the largest change
+static PetscReal blp_contraction(const Blp *model, int t, const PetscReal *sigma, const PetscReal *delta,
+                                 PetscReal *next, PetscReal *shares) {
+    long begin = model->market_begin[t];
+    int J = model->market_begin[t + 1] - begin;
+    blp_shares(model, t, sigma, delta, shares, NULL);
+    PetscReal change = 0.0;
+    for (int j = 0; j < J; ++j) {
+        next[j] = delta[j] + model->log_shares[begin + j] - log(shares[j]);
+        change = std::max(change, fabs(next[j] - delta[j]));
+    }
+    return std::isfinite(change) ? change : HUGE_VAL;
+}
+
+// Inverts the shares of market t in place, with SQUAREM steps of Varadhan and
+// Roland (2008) unless it is disabled. Returns false if it does not converge.
+static bool blp_invert(const Blp *model, int t, const PetscReal *sigma, PetscReal *delta) {
+    int J = model->market_begin[t + 1] - model->market_begin[t];
+    vector<PetscReal> d1(J), d2(J), shares(J);
+    for (int it = 0; it < BLP_MAX_ITERATIONS; ++it) {
+        PetscReal change = blp_contraction(model, t, sigma, delta, &d1[0], &shares[0]);
+        if (change < BLP_TOLERANCE) {
+            std::copy(d1.begin(), d1.end(), delta);
+            return true;
+        }
+        if (!model->squarem || change == HUGE_VAL) {
+            std::copy(d1.begin(), d1.end(), delta);
+            continue;
+        }
+        blp_contraction(model, t, sigma, &d1[0], &d2[0], &shares[0]);
+        PetscReal rr = 0.0, vv = 0.0;
+        for (int j = 0; j < J; ++j) {
+            PetscReal r = d1[j] - delta[j], v = d2[j] - 2.0 * d1[j] + delta[j];
+            rr += r * r;
+            vv += v * v;
+        }
+        PetscReal alpha = vv > 0 ? std::min(-sqrt(rr / vv), -1.0) : -1.0;
+        for (int j = 0; j < J; ++j) {
+            PetscReal r = d1[j] - delta[j], v = d2[j] - 2.0 * d1[j] + delta[j];
+            d1[j] = delta[j] - 2.0 * alpha * r + alpha * alpha * v;
+        }
+        // Fall back to the plain steps if the extrapolation leaves the domain
+        if (blp_contraction(model, t, sigma, &d1[0], delta, &shares[0]) == HUGE_VAL) {
+            std::copy(d2.begin(), d2.end(), delta);
+        }
+    }
+    return false;
+}
+
+// Solves A X = B in place by Gaussian elimination with partial pivoting, for
+// a dense n x n matrix A and n x m right-hand sides B, both row-major
+static bool solve_dense(int n, PetscReal *A, int m, PetscReal *B) {
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r) {
+            if (fabs(A[r * n + c]) > fabs(A[pivot * n + c])) {
+                pivot = r;
+            }
+        }
+        if (A[pivot * n + c] == 0.0) {
+            return false;
+        }
+        if (pivot != c) {
+            std::swap_ranges(A + c * n, A + (c + 1) * n, A + pivot * n);
+            std::swap_ranges(B + c * m, B + (c + 1) * m, B + pivot * m);
+        }
+        for (int r = c + 1; r < n; ++r) {
+            PetscReal factor = A[r * n + c] / A[c * n + c];
+            for (int i = c; i < n; ++i) {
+                A[r * n + i] -= factor * A[c * n + i];
+            }
+            for (int i = 0; i < m; ++i) {
+                B[r * m + i] -= factor * B[c * m + i];
+            }
+        }
+    }
+    for (int c = n - 1; c >= 0; --c) {
+        for (int i = 0; i < m; ++i) {
+            PetscReal sum = B[c * m + i];
+            for (int r = c + 1; r < n; ++r) {
+                sum -= A[c * n + r] * B[r * m + i];
+            }
+            B[c * m + i] = sum / A[c * n + c];
+        }
+    }
+    return true;
+}
+
+// The moments Z'xi of market t and, unless jacobian is NULL, Z' ddelta/dsigma
+static int blp_market(Blp *model, int t, const PetscReal *x, PetscReal *moments, PetscReal *jacobian) {
+
+    long begin = model->market_begin[t];
+    int J = model->market_begin[t + 1] - begin, k1 = model->k1, k2 = model->k2, L = model->instruments;
+    int R = model->draws;
+    const PetscReal *sigma = x + k1;
+    PetscReal *delta = &model->delta[begin];
+
+    if (!blp_invert(model, t, sigma, delta)) {
+        // Start the next evaluation from the logit inversion
+        for (int j = 0; j < J; ++j) {
+            delta[j] = model->log_shares[begin + j];
+        }
+        return 1;
+    }
+    std::fill(moments, moments + L, 0.0);
+    for (int j = 0; j < J; ++j) {
+        const PetscReal *z = &model->z[(size_t) (begin + j) * L];
+        const PetscReal *x1 = &model->x1[(size_t) (begin + j) * k1];
+        PetscReal xi = delta[j];
+        for (int l = 0; l < k1; ++l) {
+            xi -= x1[l] * x[l];
+        }
+        for (int l = 0; l < L; ++l) {
+            moments[l] += z[l] * xi;
+        }
+    }
+    if (jacobian == NULL) {
+        return 0;
+    }
+
+    // ds/ddelta and -ds/dsigma from the shares of each consumer
+    vector<PetscReal> shares(J), per_draw((size_t) R * J), D((size_t) J * J, 0.0), E((size_t) J * k2, 0.0);
+    vector<PetscReal> mean(k2);
+    const PetscReal *nu = &model->nu[(size_t) t * R * k2];
+    blp_shares(model, t, sigma, delta, &shares[0], &per_draw[0]);
+    for (int r = 0; r < R; ++r) {
+        const PetscReal *s = &per_draw[(size_t) r * J];
+        std::fill(mean.begin(), mean.end(), 0.0);
+        for (int j = 0; j < J; ++j) {
+            const PetscReal *x2 = &model->x2[(size_t) (begin + j) * k2];
+            for (int l = 0; l < k2; ++l) {
+                mean[l] += s[j] * x2[l] * nu[r * k2 + l];
+            }
+        }
+        for (int j = 0; j < J; ++j) {
+            const PetscReal *x2 = &model->x2[(size_t) (begin + j) * k2];
+            for (int i = 0; i < J; ++i) {
+                D[(size_t) j * J + i] += s[j] * ((i == j) - s[i]) / R;
+            }
+            for (int l = 0; l < k2; ++l) {
+                E[(size_t) j * k2 + l] -= s[j] * (x2[l] * nu[r * k2 + l] - mean[l]) / R;
+            }
+        }
+    }
+    if (!solve_dense(J, &D[0], k2, &E[0])) {
+        return 2;
+    }
+    std::fill(jacobian, jacobian + (size_t) L * k2, 0.0);
+    for (int j = 0; j < J; ++j) {
+        const PetscReal *z = &model->z[(size_t) (begin + j) * L];
+        for (int l = 0; l < L; ++l) {
+            for (int m = 0; m < k2; ++m) {
+                jacobian[l * k2 + m] += z[l] * E[(size_t) j * k2 + m];
+            }
+        }
+    }
+    return 0;
+}
+
+// solves L y = b in place for the lower triangular Cholesky factor
+static void blp_forward(const Blp *model, PetscReal *b, int stride) {
+    int L = model->instruments;
+    for (int i = 0; i < L; ++i) {
+        for (int c = 0; c < stride; ++c) {
+            PetscReal sum = b[i * stride + c];
+            for (int j = 0; j < i; ++j) {
+                sum -= model->cholesky[i * L + j] * b[j * stride + c];
+            }
+            b[i * stride + c] = sum / model->cholesky[i * L + i];
+        }
+    }
+}
+
+static PetscErrorCode blp_evaluate(int k, const PetscReal *x, bool gradient, Blp *model) {
+
+    int k1 = model->k1, k2 = model->k2, L = model->instruments;
+    int markets = model->market_begin.size() - 1;
+
+    PetscFunctionBegin;
+    if (k != k1 + k2) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", k1 + k2, k);
+    }
+    if (model->has_r && (model->has_dr || !gradient) && std::equal(x, x + k, model->last_x.begin())) {
+        PetscFunctionReturn(0);
+    }
+
+    int threads = pool_threads(model->pool);
+    model->moments.resize((size_t) markets * L);
+    model->jacobian.resize(gradient ? (size_t) markets * L * k2 : 0);
+    pool_run(model->pool, [&](int thread) {
+        long first, last;
+        pool_share(markets, threads, thread, &first, &last);
+        model->error[thread] = 0;
+        for (long t = first; t < last && model->error[thread] == 0; ++t) {
+            model->error[thread] = blp_market(model, t, x, &model->moments[t * L],
+                                              gradient ? &model->jacobian[t * L * k2] : NULL);
+        }
+    });
+    for (size_t t = 0; t < model->error.size(); ++t) {
+        if (model->error[t] == 1) {
+            SETERRQ1(PETSC_COMM_SELF, PETSC_ERR_NOT_CONVERGED, "The shares did not invert in %d iterations",
+                     BLP_MAX_ITERATIONS);
+        } else if (model->error[t] != 0) {
+            SETERRQ(PETSC_COMM_SELF, PETSC_ERR_MAT_LU_ZRPVT, "The derivatives of the shares are singular");
+        }
+    }
+
+    // Add up the markets in their order, then the residuals are L^-1 g
+    model->last_r.assign(L, 0.0);
+    for (int t = 0; t < markets; ++t) {
+        for (int l = 0; l < L; ++l) {
+            model->last_r[l] += model->moments[t * L + l] / model->products;
+        }
+    }
+    blp_forward(model, &model->last_r[0], 1);
+    if (gradient) {
+        model->last_dr.assign((size_t) L * k, 0.0);
+        for (int l = 0; l < L; ++l) {
+            for (int m = 0; m < k1; ++m) {
+                model->last_dr[l * k + m] = model->zx1[l * k1 + m];
+            }
+        }
+        for (int t = 0; t < markets; ++t) {
+            for (int l = 0; l < L; ++l) {
+                for (int m = 0; m < k2; ++m) {
+                    model->last_dr[l * k + k1 + m] += model->jacobian[((size_t) t * L + l) * k2 + m] / model->products;
+                }
+            }
+        }
+        blp_forward(model, &model->last_dr[0], k);
+    }
+    model->last_x.assign(x, x + k);
+    model->has_r = true;
+    model->has_dr = gradient;
+    PetscFunctionReturn(0);
+}
+
+static PetscReal blp_sum_of_squares(Blp *model) {
+    PetscReal f = 0.0;
+    for (size_t l = 0; l < model->last_r.size(); ++l) {
+        f += model->last_r[l] * model->last_r[l];
+    }
+    return f;
+}
+
+// the gradient is 2 * J'r, with the Jacobian J of the residuals
+static void blp_gradient_of(Blp *model, int k, PetscReal *g) {
+    std::fill(g, g + k, 0.0);
+    for (int l = 0; l < model->instruments; ++l) {
+        for (int m = 0; m < k; ++m) {
+            g[m] += 2.0 * model->last_dr[l * k + m] * model->last_r[l];
+        }
+    }
+}
+
+static PetscErrorCode blp_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    Blp *model = (Blp *) data;
+    PetscFunctionBegin;
+    catch_error(blp_evaluate(k, x, false, model));
+    *f = blp_sum_of_squares(model);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode blp_separable(int k, const PetscReal *x, int n, PetscReal *y, void *data) {
+    Blp *model = (Blp *) data;
+    PetscFunctionBegin;
+    catch_error(blp_evaluate(k, x, false, model));
+    std::copy(model->last_r.begin(), model->last_r.end(), y);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode blp_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    Blp *model = (Blp *) data;
+    PetscFunctionBegin;
+    catch_error(blp_evaluate(k, x, true, model));
+    blp_gradient_of(model, k, g);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode blp_objective_gradient(int k, const PetscReal *x, PetscReal *f, PetscReal *g, void *data) {
+    Blp *model = (Blp *) data;
+    PetscFunctionBegin;
+    catch_error(blp_evaluate(k, x, true, model));
+    *f = blp_sum_of_squares(model);
+    blp_gradient_of(model, k, g);
+    PetscFunctionReturn(0);
+}
+
+static void blp_destroy(void *data) {
+    Blp *model = (Blp *) data;
+    pool_destroy(model->pool);
+    delete model;
+}
+
+// copies a matrix from R into row-major order
+static vector<PetscReal> blp_matrix(List data, const char *name, int rows, int *cols) {
+    if (!data.containsElementNamed(name)) {
+        stop(string("model data must contain ") + name + ".");
+    }
+    NumericMatrix matrix = data[name];
+    if (matrix.nrow() != rows) {
+        stop(string(name) + " must have one row per product.");
+    }
+    *cols = matrix.ncol();
+    vector<PetscReal> values((size_t) rows * *cols);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < *cols; ++j) {
+            values[(size_t) i * *cols + j] = matrix(i, j);
+        }
+    }
+    return values;
+}
+
+Native *create_blp(List data) {
+
+    std::unique_ptr<Blp> model(new Blp());
+    vector<PetscReal> market = model_vector(data, "market");
+    vector<PetscReal> shares = model_vector(data, "shares");
+    int N = market.size();
+    if (N == 0 || (int) shares.size() != N) {
+        stop("market and shares must have the same positive length.");
+    }
+    model->products = N;
+    model->x1 = blp_matrix(data, "X1", N, &model->k1);
+    model->x2 = blp_matrix(data, "X2", N, &model->k2);
+    model->z = blp_matrix(data, "Z", N, &model->instruments);
+    model->draws = data.containsElementNamed("draws") ? model_size(data, "draws") : 100;
+    model->squarem = !data.containsElementNamed("squarem") || as<bool>(data["squarem"]);
+    if (model->instruments < model->k1 + model->k2 || model->draws < 1) {
+        stop("the model needs at least as many instruments as parameters and one draw.");
+    }
+
+    // The markets are runs of the same market id, and their shares leave room
+    // for the outside good
+    PetscReal inside = 0.0;
+    for (int i = 0; i < N; ++i) {
+        if (i == 0 || market[i] != market[i - 1]) {
+            if (i > 0 && !(inside < 1.0)) {
+                stop("the shares of each market must add up to less than one.");
+            }
+            model->market_begin.push_back(i);
+            inside = 0.0;
+        }
+        if (!(shares[i] > 0.0)) {
+            stop("shares must be positive.");
+        }
+        inside += shares[i];
+    }
+    if (!(inside < 1.0)) {
+        stop("the shares of each market must add up to less than one.");
+    }
+    model->market_begin.push_back(N);
+    int markets = model->market_begin.size() - 1;
+
+    // The logit inversion log(s_j) - log(s_0) starts the first evaluation
+    model->log_shares.resize(N);
+    model->delta.resize(N);
+    for (int t = 0; t < markets; ++t) {
+        PetscReal outside = 1.0;
+        for (long i = model->market_begin[t]; i < model->market_begin[t + 1]; ++i) {
+            outside -= shares[i];
+        }
+        for (long i = model->market_begin[t]; i < model->market_begin[t + 1]; ++i) {
+            model->log_shares[i] = log(shares[i]);
+            model->delta[i] = log(shares[i]) - log(outside);
+        }
+    }
+
+    // The draws of the consumers of each market
+    std::mt19937_64 random(data.containsElementNamed("seed") ? model_size(data, "seed") : 1);
+    std::normal_distribution<PetscReal> normal(0.0, 1.0);
+    model->nu.resize((size_t) markets * model->draws * model->k2);
+    std::generate(model->nu.begin(), model->nu.end(), [&]() { return normal(random); });
+
+    // The Cholesky factor of Z'Z / N and the constant derivatives -Z'X1 / N
+    int L = model->instruments, k1 = model->k1;
+    model->cholesky.assign((size_t) L * L, 0.0);
+    model->zx1.assign((size_t) L * k1, 0.0);
+    for (int i = 0; i < N; ++i) {
+        const PetscReal *z = &model->z[(size_t) i * L];
+        for (int a = 0; a < L; ++a) {
+            for (int b = 0; b <= a; ++b) {
+                model->cholesky[a * L + b] += z[a] * z[b] / N;
+            }
+            for (int m = 0; m < k1; ++m) {
+                model->zx1[a * k1 + m] -= z[a] * model->x1[(size_t) i * k1 + m] / N;
+            }
+        }
+    }
+    for (int j = 0; j < L; ++j) {
+        PetscReal *C = &model->cholesky[0];
+        for (int m = 0; m < j; ++m) {
+            C[j * L + j] -= C[j * L + m] * C[j * L + m];
+        }
+        if (!(C[j * L + j] > 0.0)) {
+            stop("the instruments are collinear.");
+        }
+        C[j * L + j] = sqrt(C[j * L + j]);
+        for (int i = j + 1; i < L; ++i) {
+            for (int m = 0; m < j; ++m) {
+                C[i * L + j] -= C[i * L + m] * C[j * L + m];
+            }
+            C[i * L + j] /= C[j * L + j];
+        }
+    }
+
+    int threads = std::max(data.containsElementNamed("threads") ? model_size(data, "threads") : 1, 1);
+    model->pool = threads > 1 ? pool_create(threads) : NULL;
+    model->error.resize(threads);
+
+    Native *native = new Native();
+    native->objfun = blp_objective;
+    native->grafun = blp_gradient;
+    native->objgrad = blp_objective_gradient;
+    native->sepfun = blp_separable;
+    native->n = L;
+    native->moments = 1;
+    native->data = model.release();
+    native->destroy = blp_destroy;
+    return native;
+}
@@ -0,0 +1,199 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <petsctime.h>
+#include <limits>
+#include "utils.h"
+#include "budget.h"
+
+static const char *REASON_NAMES[] = {"", "BUDGET_TIME", "BUDGET_EVALUATIONS", "INTERRUPTED"};
+
+// interrupts are checked at most this often, in seconds
+static const double INTERRUPT_INTERVAL = 0.1;
+
+static void check_interrupt(void *data) {
+    R_CheckUserInterrupt();
+}
+
+// Checks for a pending interrupt without unwinding out of PETSc. Only the R
+// thread can be interrupted.
+static bool interrupt_pending(Budget *budget, PetscLogDouble now) {
+    if (now - budget->last_interrupt_check < INTERRUPT_INTERVAL || !on_r_thread()) {
+        return false;
+    }
+    budget->last_interrupt_check = now;
+    return R_ToplevelExec(check_interrupt, NULL) == FALSE;
+}
+
+// Sets budget->exhausted if a limit was reached.
+static PetscErrorCode budget_update(Budget *budget) {
+
+    PetscLogDouble now;
+
+    PetscFunctionBegin;
+    if (budget->exhausted != BUDGET_AVAILABLE) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(PetscTime(&now));
+    if (budget->max_time > 0 && now - budget->start >= budget->max_time) {
+        budget->exhausted = BUDGET_TIME;
+    } else if (budget->max_evaluations > 0 && budget->evaluations >= budget->max_evaluations) {
+        budget->exhausted = BUDGET_EVALUATIONS;
+    } else if (interrupt_pending(budget, now)) {
+        budget->exhausted = BUDGET_INTERRUPT;
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode budget_stop(Budget *budget, Tao tao_context) {
+
+    PetscFunctionBegin;
+    if (budget->exhausted == BUDGET_EVALUATIONS) {
+        catch_error(TaoSetConvergedReason(tao_context, TAO_DIVERGED_MAXFCN));
+    } else {
+        catch_error(TaoSetConvergedReason(tao_context, TAO_DIVERGED_USER));
+    }
+    PetscFunctionReturn(0);
+}
+
+// Stays silent about the errors that unwind a solve whose budget is exhausted
+static PetscErrorCode budget_error_handler(MPI_Comm comm, int line, const char *function,
+                                           const char *file, PetscErrorCode error,
+                                           PetscErrorType type, const char *message, void *ptr) {
+    Budget *budget = (Budget *) ptr;
+    if (budget->exhausted != BUDGET_AVAILABLE && error == BUDGET_EXHAUSTED) {
+        return error;
+    }
+    return PetscTraceBackErrorHandler(comm, line, function, file, error, type, message, NULL);
+}
+
+Budget *budget_create(List settings) {
+
+    Budget *budget = new Budget();
+    PetscTime(&budget->start);
+    budget->last_interrupt_check = budget->start;
+    budget->max_time = 0;
+    budget->max_evaluations = 0;
+    budget->evaluations = 0;
+    budget->exhausted = BUDGET_AVAILABLE;
+    budget->best_f = std::numeric_limits<PetscReal>::infinity();
+
+    if (settings.containsElementNamed("max_time")) {
+        budget->max_time = as<double>(settings["max_time"]);
+    }
+    if (settings.containsElementNamed("max_evaluations")) {
+        budget->max_evaluations = (long) as<double>(settings["max_evaluations"]);
+    }
+    return budget;
+}
+
+PetscErrorCode budget_check(Budget *budget, Tao tao_context) {
+
+    PetscFunctionBegin;
+    if (budget == NULL) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(budget_update(budget));
+    if (budget->exhausted != BUDGET_AVAILABLE) {
+        catch_error(budget_stop(budget, tao_context));
+    }
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode budget_spend(Budget *budget, Tao tao_context) {
+
+    PetscFunctionBegin;
+    if (budget == NULL) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(budget_update(budget));
+    if (budget->exhausted != BUDGET_AVAILABLE) {
+        catch_error(budget_stop(budget, tao_context));
+        PetscFunctionReturn(BUDGET_EXHAUSTED);
+    }
+    budget->evaluations++;
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode budget_record(Budget *budget, Vec X, PetscReal f) {
+
+    const PetscReal *x;
+    PetscInt k;
+
+    PetscFunctionBegin;
+    if (budget == NULL || !(f < budget->best_f)) {
+        PetscFunctionReturn(0);
+    }
+    budget->best_f = f;
+    catch_error(VecGetSize(X, &k));
+    catch_error(VecGetArrayRead(X, &x));
+    budget->best_x.assign(x, x + k);
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode budget_record(Budget *budget, Vec X, Vec F) {
+
+    const PetscReal *y;
+    PetscReal f;
+    PetscInt n;
+
+    PetscFunctionBegin;
+    if (budget == NULL) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(VecDot(F, F, &f));
+    if (!(f < budget->best_f)) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(budget_record(budget, X, f));
+    catch_error(VecGetSize(F, &n));
+    catch_error(VecGetArrayRead(F, &y));
+    budget->best_y.assign(y, y + n);
+    catch_error(VecRestoreArrayRead(F, &y));
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode budget_push_handler(Budget *budget) {
+    return PetscPushErrorHandler(budget_error_handler, budget);
+}
+
+PetscErrorCode budget_pop_handler(Budget *budget) {
+    return PetscPopErrorHandler();
+}
+
+double budget_elapsed(Budget *budget) {
+    PetscLogDouble now;
+    PetscTime(&now);
+    return now - budget->start;
+}
+
+string budget_reason(Budget *budget, Tao tao_context) {
+
+    TaoConvergedReason reason;
+
+    if (budget != NULL && budget->exhausted != BUDGET_AVAILABLE) {
+        return REASON_NAMES[budget->exhausted];
+    }
+    TaoGetConvergedReason(tao_context, &reason);
+    return TaoConvergedReasons[reason];
+}
+
+void budget_destroy(Budget *budget) {
+    delete budget;
+}
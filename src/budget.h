@@ -0,0 +1,101 @@
+#ifndef budget_h
+#define budget_h
+
+#include "taoR.h"
+
+// Reasons for which the budget of a solve is exhausted.
+enum {
+    BUDGET_AVAILABLE = 0,
+    BUDGET_TIME = 1,
+    BUDGET_EVALUATIONS = 2,
+    BUDGET_INTERRUPT = 3
+};
+
+// Error code returned by the callbacks once the budget is exhausted. It
+// unwinds TaoSolve without printing a traceback.
+#define BUDGET_EXHAUSTED PETSC_ERR_USER
+
+// Limits on the wall-clock time and the number of evaluations of a solve.
+// Once a limit is reached or the user interrupts R, the solve is stopped and
+// the best point seen so far is returned instead of the last iterate.
+struct Budget {
+    PetscLogDouble start;
+    PetscLogDouble last_interrupt_check;
+    double max_time;
+    long max_evaluations;
+    long evaluations;
+    int exhausted;
+    PetscReal best_f;
+    vector<PetscReal> best_x;
+    vector<PetscReal> best_y;
+};
+
+// Creates a budget. Limits that are not set are unlimited.
+//
+// @param settings is a list with max_time in seconds and max_evaluations.
+// @returns The budget, to be released with budget_destroy.
+Budget *budget_create(List settings);
+
+// Checks the budget between iterations and stops the solve through its
+// converged reason if the budget is exhausted.
+//
+// @param budget The budget, may be NULL.
+// @param tao_context The TAO context.
+// @returns Error code.
+PetscErrorCode budget_check(Budget *budget, Tao tao_context);
+
+// Spends one evaluation. If the budget is exhausted, the solve is stopped
+// and BUDGET_EXHAUSTED is returned, so that no further evaluation happens.
+//
+// @param budget The budget, may be NULL.
+// @param tao_context The TAO context.
+// @returns Error code.
+PetscErrorCode budget_spend(Budget *budget, Tao tao_context);
+
+// Remembers the point if it is the best seen so far.
+//
+// @param budget The budget, may be NULL.
+// @param X The parameter values.
+// @param f The objective function value.
+// @returns Error code.
+PetscErrorCode budget_record(Budget *budget, Vec X, PetscReal f);
+
+// Remembers the point if it is the best seen so far, for a separable
+// objective function whose value is the sum of squares of F.
+PetscErrorCode budget_record(Budget *budget, Vec X, Vec F);
+
+// Installs an error handler that is silent while the budget is exhausted.
+PetscErrorCode budget_push_handler(Budget *budget);
+
+// Removes the error handler installed by budget_push_handler.
+PetscErrorCode budget_pop_handler(Budget *budget);
+
+// Installs the error handler of the budget for the lifetime of the scope, such
+// that it is also removed if R throws an exception from a callback.
+class BudgetHandlerScope {
+public:
+    explicit BudgetHandlerScope(Budget *budget) : budget(budget) {
+        budget_push_handler(budget);
+    }
+    ~BudgetHandlerScope() {
+        budget_pop_handler(budget);
+    }
+private:
+    Budget *budget;
+};
+
+// The number of seconds since the budget was created.
+double budget_elapsed(Budget *budget);
+
+// The reason for which the solve stopped, either the reason for which the
+// budget was exhausted or the TAO converged reason.
+//
+// @param budget The budget, may be NULL.
+// @param tao_context The TAO context.
+// @returns The name of the reason.
+string budget_reason(Budget *budget, Tao tao_context);
+
+// Frees the budget.
+void budget_destroy(Budget *budget);
+
+#endif
@@ -0,0 +1,260 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+// layout of the header, the parameter vectors x0 and x follow at the end
+static const char CHECKPOINT_MAGIC[8] = {'t', 'a', 'o', 'R', 'c', 'k', 'p', 't'};
+static const int32_t CHECKPOINT_VERSION = 1;
+static const long OFFSET_ITERATION = 20;
+static const long OFFSET_RADIUS = 40;
+static const long OFFSET_X0 = 64;
+
+// number of function values stored for an evaluation type
+static int values_per_record(Checkpoint *checkpoint, int type) {
+    switch (type) {
+        case CHECKPOINT_OBJECTIVE: return 1;
+        case CHECKPOINT_SEPARABLE: return checkpoint->n;
+        default: return checkpoint->k;
+    }
+}
+
+// the history is keyed by the evaluation type and the bit pattern of x
+static string history_key(int type, const PetscReal *x, int k) {
+    string key(1, (char) type);
+    key.append((const char *) x, k * sizeof(PetscReal));
+    return key;
+}
+
+static bool read_checkpoint(Checkpoint *checkpoint) {
+
+    FILE *file = checkpoint->file;
+    int k = checkpoint->k;
+    char magic[8], method[16];
+    int32_t version, k_file, n_file, iteration;
+    PetscReal radius, f;
+    int64_t records;
+
+    if (fread(magic, 1, 8, file) != 8 || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0 ||
+        fread(&version, sizeof(int32_t), 1, file) != 1 || version != CHECKPOINT_VERSION ||
+        fread(&k_file, sizeof(int32_t), 1, file) != 1 ||
+        fread(&n_file, sizeof(int32_t), 1, file) != 1 ||
+        fread(&iteration, sizeof(int32_t), 1, file) != 1 ||
+        fread(method, 1, 16, file) != 16 ||
+        fread(&radius, sizeof(PetscReal), 1, file) != 1 ||
+        fread(&f, sizeof(PetscReal), 1, file) != 1 ||
+        fread(&records, sizeof(int64_t), 1, file) != 1) {
+        return false;
+    }
+
+    method[15] = '\0';
+    if (k_file != k || n_file != checkpoint->n || checkpoint->method != method) {
+        return false;
+    }
+
+    if (fread(&checkpoint->x0[0], sizeof(PetscReal), k, file) != (size_t) k) {
+        return false;
+    }
+
+    // skip the current iterate, the solve is replayed from the starting values
+    vector<PetscReal> x(k);
+    if (fread(&x[0], sizeof(PetscReal), k, file) != (size_t) k) {
+        return false;
+    }
+
+    for (int64_t i = 0; i < records; ++i) {
+        int32_t type[2];
+        if (fread(type, sizeof(int32_t), 2, file) != 2 ||
+            type[0] < CHECKPOINT_OBJECTIVE || type[0] > CHECKPOINT_GRADIENT ||
+            fread(&x[0], sizeof(PetscReal), k, file) != (size_t) k) {
+            return false;
+        }
+        vector<PetscReal> y(values_per_record(checkpoint, type[0]));
+        if (fread(&y[0], sizeof(PetscReal), y.size(), file) != y.size()) {
+            return false;
+        }
+        checkpoint->history[history_key(type[0], &x[0], k)] = y;
+    }
+    checkpoint->records = records;
+
+    // discard anything that was written after the last complete checkpoint
+    long end = ftell(file);
+    if (ftruncate(fileno(file), end) != 0 || fseek(file, end, SEEK_SET) != 0) {
+        return false;
+    }
+    return true;
+}
+
+static bool write_header(Checkpoint *checkpoint) {
+
+    FILE *file = checkpoint->file;
+    int k = checkpoint->k;
+    char method[16] = {0};
+    int32_t header[4] = {CHECKPOINT_VERSION, k, checkpoint->n, 0};
+    PetscReal state[2] = {0.0, NAN};
+    int64_t records = 0;
+
+    strncpy(method, checkpoint->method.c_str(), 15);
+    return fwrite(CHECKPOINT_MAGIC, 1, 8, file) == 8 &&
+           fwrite(header, sizeof(int32_t), 4, file) == 4 &&
+           fwrite(method, 1, 16, file) == 16 &&
+           fwrite(state, sizeof(PetscReal), 2, file) == 2 &&
+           fwrite(&records, sizeof(int64_t), 1, file) == 1 &&
+           fwrite(&checkpoint->x0[0], sizeof(PetscReal), k, file) == (size_t) k &&
+           fwrite(&checkpoint->x0[0], sizeof(PetscReal), k, file) == (size_t) k &&
+           fflush(file) == 0;
+}
+
+Checkpoint *checkpoint_open(string path, int every, string method, NumericVector start_values, int n) {
+
+    if (method.size() > 15) {
+        stop("method name is too long to be stored in a checkpoint.");
+    }
+
+    Checkpoint *checkpoint = new Checkpoint();
+    checkpoint->path = path;
+    checkpoint->every = every > 0 ? every : 1;
+    checkpoint->k = start_values.size();
+    checkpoint->n = n;
+    checkpoint->method = method;
+    checkpoint->x0.assign(start_values.begin(), start_values.end());
+    checkpoint->records = 0;
+    checkpoint->replayed = 0;
+    checkpoint->unwritten = 0;
+
+    // resume from an existing checkpoint, unless the file is empty
+    checkpoint->file = fopen(path.c_str(), "r+b");
+    if (checkpoint->file != NULL && (fseek(checkpoint->file, 0, SEEK_END) != 0 || ftell(checkpoint->file) > 0)) {
+        rewind(checkpoint->file);
+        if (!read_checkpoint(checkpoint)) {
+            checkpoint_close(checkpoint);
+            stop("cannot resume from checkpoint " + path +
+                 ": the file is corrupt or belongs to a different problem.");
+        }
+        return checkpoint;
+    }
+
+    if (checkpoint->file != NULL) {
+        fclose(checkpoint->file);
+    }
+    checkpoint->file = fopen(path.c_str(), "w+b");
+    if (checkpoint->file == NULL || !write_header(checkpoint)) {
+        checkpoint_close(checkpoint);
+        stop("cannot create checkpoint " + path + ".");
+    }
+    return checkpoint;
+}
+
+bool checkpoint_replay(Checkpoint *checkpoint, int type, const PetscReal *x, PetscReal *y) {
+
+    if (checkpoint == NULL) {
+        return false;
+    }
+
+    unordered_map<string, vector<PetscReal> >::const_iterator it =
+        checkpoint->history.find(history_key(type, x, checkpoint->k));
+    if (it == checkpoint->history.end()) {
+        return false;
+    }
+
+    std::copy(it->second.begin(), it->second.end(), y);
+    checkpoint->replayed++;
+    return true;
+}
+
+void checkpoint_record(Checkpoint *checkpoint, int type, const PetscReal *x, const PetscReal *y) {
+
+    if (checkpoint == NULL) {
+        return;
+    }
+
+    int k = checkpoint->k;
+    int m = values_per_record(checkpoint, type);
+    int32_t header[2] = {type, 0};
+
+    checkpoint->history[history_key(type, x, k)] = vector<PetscReal>(y, y + m);
+    checkpoint->pending.append((const char *) header, sizeof(header));
+    checkpoint->pending.append((const char *) x, k * sizeof(PetscReal));
+    checkpoint->pending.append((const char *) y, m * sizeof(PetscReal));
+    checkpoint->unwritten++;
+}
+
+PetscErrorCode checkpoint_write(Checkpoint *checkpoint, Tao tao_context) {
+
+    PetscInt its;
+    PetscReal state[2];
+    Vec X;
+    const PetscReal *x;
+
+    PetscFunctionBegin;
+    if (checkpoint == NULL) {
+        PetscFunctionReturn(0);
+    }
+
+    catch_error(TaoGetSolutionStatus(tao_context, &its, &state[1], 0, 0, 0, 0));
+    catch_error(TaoGetCurrentTrustRegionRadius(tao_context, &state[0]));
+    catch_error(TaoGetSolutionVector(tao_context, &X));
+
+    FILE *file = checkpoint->file;
+    int k = checkpoint->k;
+    int32_t iteration = its;
+    int64_t records = checkpoint->records + checkpoint->unwritten;
+
+    // append the new evaluations and make them durable before the header
+    // refers to them, a crash in between leaves unreferenced records
+    bool ok = fseek(file, 0, SEEK_END) == 0 &&
+              fwrite(checkpoint->pending.data(), 1, checkpoint->pending.size(), file) == checkpoint->pending.size() &&
+              fflush(file) == 0 &&
+              (checkpoint->pending.empty() || fsync(fileno(file)) == 0);
+
+    catch_error(VecGetArrayRead(X, &x));
+    ok = ok &&
+         fseek(file, OFFSET_ITERATION, SEEK_SET) == 0 &&
+         fwrite(&iteration, sizeof(int32_t), 1, file) == 1 &&
+         fseek(file, OFFSET_RADIUS, SEEK_SET) == 0 &&
+         fwrite(state, sizeof(PetscReal), 2, file) == 2 &&
+         fwrite(&records, sizeof(int64_t), 1, file) == 1 &&
+         fseek(file, OFFSET_X0 + k * sizeof(PetscReal), SEEK_SET) == 0 &&
+         fwrite(x, sizeof(PetscReal), k, file) == (size_t) k &&
+         fflush(file) == 0 &&
+         fsync(fileno(file)) == 0;
+    catch_error(VecRestoreArrayRead(X, &x));
+
+    if (!ok) {
+        SETERRQ1(PETSC_COMM_SELF, PETSC_ERR_FILE_WRITE, "Cannot write checkpoint %s", checkpoint->path.c_str());
+    }
+
+    checkpoint->records = records;
+    checkpoint->unwritten = 0;
+    checkpoint->pending.clear();
+    PetscFunctionReturn(0);
+}
+
+void checkpoint_close(Checkpoint *checkpoint) {
+
+    if (checkpoint == NULL) {
+        return;
+    }
+
+    if (checkpoint->file != NULL) {
+        fclose(checkpoint->file);
+    }
+    delete checkpoint;
+}
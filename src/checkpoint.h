@@ -0,0 +1,79 @@
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include "taoR.h"
+#include <unordered_map>
+
+// Types of evaluations that are recorded in a checkpoint.
+enum {
+    CHECKPOINT_OBJECTIVE = 0,
+    CHECKPOINT_SEPARABLE = 1,
+    CHECKPOINT_GRADIENT = 2
+};
+
+// A checkpoint file holds a fixed-size header with the starting values, the
+// current iterate, the trust-region radius and the number of recorded
+// evaluations, followed by the evaluation history. Each record consists of the
+// evaluation type, the parameter values, and the function values.
+//
+// New evaluations are buffered in memory and appended to the file whenever
+// the checkpoint is written; the header is updated last so that a file that
+// was cut off mid-write remains valid.
+struct Checkpoint {
+    string path;
+    FILE *file;
+    int every;
+    int k;
+    int n;
+    string method;
+    vector<PetscReal> x0;
+    long records;
+    long replayed;
+    long unwritten;
+    unordered_map<string, vector<PetscReal> > history;
+    string pending;
+};
+
+// Opens a checkpoint file. If the file exists, its evaluation history is read
+// so that these evaluations can be replayed, and x0 holds the starting values
+// stored in the file. Otherwise, a new file is created.
+//
+// @param path The path of the checkpoint file.
+// @param every Write the checkpoint every this many iterations.
+// @param method The TAO method.
+// @param start_values The starting values.
+// @param n The number of elements of the objective function.
+// @returns A new checkpoint, to be released with checkpoint_close.
+Checkpoint *checkpoint_open(string path, int every, string method, NumericVector start_values, int n);
+
+// Looks up an evaluation in the history of a checkpoint.
+//
+// @param checkpoint The checkpoint, may be NULL.
+// @param type The evaluation type.
+// @param x The parameter values.
+// @param y Receives the recorded function values.
+// @returns Whether the evaluation was found.
+bool checkpoint_replay(Checkpoint *checkpoint, int type, const PetscReal *x, PetscReal *y);
+
+// Adds an evaluation to the history of a checkpoint.
+//
+// @param checkpoint The checkpoint, may be NULL.
+// @param type The evaluation type.
+// @param x The parameter values.
+// @param y The function values.
+void checkpoint_record(Checkpoint *checkpoint, int type, const PetscReal *x, const PetscReal *y);
+
+// Appends all new evaluations and the current state of the solver to the
+// checkpoint file.
+//
+// @param checkpoint The checkpoint, may be NULL.
+// @param tao_context The TAO context.
+// @returns Error code.
+PetscErrorCode checkpoint_write(Checkpoint *checkpoint, Tao tao_context);
+
+// Closes the checkpoint file and frees the checkpoint.
+//
+// @param checkpoint The checkpoint, may be NULL.
+void checkpoint_close(Checkpoint *checkpoint);
+
+#endif
@@ -0,0 +1,392 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include "utils.h"
+#include "sum.h"
+#include "covariance.h"
+
+// the number of steps of the BFGS approximation, as in TAO's lmvm
+static const size_t BFGS_MEMORY = 5;
+
+Covariance *covariance_create(string method, Problem *problem, bool separable) {
+    Native *native = problem->native;
+    Covariance *covariance = new Covariance();
+    covariance->method = method;
+    covariance->k = problem->k;
+    covariance->residuals = !separable ? 0 : native != NULL ? native->n : problem->n;
+    covariance->moments = separable && native != NULL && native->moments != 0;
+    covariance->gradient = native != NULL ? native->grafun != NULL || native->objgrad != NULL
+                                          : problem->grafun != NULL;
+    covariance->hessian = native != NULL ? native->hesfun != NULL : problem->hesfun != NULL;
+    covariance->has_last = false;
+    if (method == "gn" && !separable) {
+        delete covariance;
+        stop("the Gauss-Newton approximation requires residuals, see method pounders.");
+    }
+    if (method == "bfgs" && (!covariance->gradient || separable)) {
+        delete covariance;
+        stop("the BFGS approximation requires a gradient.");
+    }
+    return covariance;
+}
+
+PetscErrorCode covariance_record(Covariance *covariance, Tao tao_context) {
+
+    Vec X, G;
+    const PetscReal *x, *g;
+
+    PetscFunctionBegin;
+    if (covariance == NULL || covariance->method != "bfgs") {
+        PetscFunctionReturn(0);
+    }
+    catch_error(TaoGetSolutionVector(tao_context, &X));
+    catch_error(TaoGetGradientVector(tao_context, &G));
+    if (G == NULL) {
+        PetscFunctionReturn(0);
+    }
+    int k = covariance->k;
+    catch_error(VecGetArrayRead(X, &x));
+    catch_error(VecGetArrayRead(G, &g));
+
+    // Keep the pairs with positive curvature, the oldest is dropped
+    if (covariance->has_last) {
+        vector<PetscReal> s(k), y(k);
+        PetscReal sy = 0.0;
+        for (int i = 0; i < k; ++i) {
+            s[i] = x[i] - covariance->last_x[i];
+            y[i] = g[i] - covariance->last_g[i];
+            sy += s[i] * y[i];
+        }
+        if (sy > DBL_EPSILON) {
+            if (covariance->s.size() >= BFGS_MEMORY * k) {
+                covariance->s.erase(covariance->s.begin(), covariance->s.begin() + k);
+                covariance->y.erase(covariance->y.begin(), covariance->y.begin() + k);
+            }
+            covariance->s.insert(covariance->s.end(), s.begin(), s.end());
+            covariance->y.insert(covariance->y.end(), y.begin(), y.end());
+        }
+    }
+    covariance->last_x.assign(x, x + k);
+    covariance->last_g.assign(g, g + k);
+    covariance->has_last = true;
+    catch_error(VecRestoreArrayRead(G, &g));
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+// The BFGS approximation of the inverse Hessian, starting from the scaled
+// identity (s'y / y'y) I of the last pair
+static void covariance_bfgs(Covariance *covariance, PetscReal *inverse) {
+    int k = covariance->k;
+    size_t pairs = covariance->s.size() / k;
+    const PetscReal *s = &covariance->s[(pairs - 1) * k], *y = &covariance->y[(pairs - 1) * k];
+    PetscReal sy = 0.0, yy = 0.0;
+    for (int i = 0; i < k; ++i) {
+        sy += s[i] * y[i];
+        yy += y[i] * y[i];
+    }
+    std::fill(inverse, inverse + k * k, 0.0);
+    for (int i = 0; i < k; ++i) {
+        inverse[i * k + i] = sy / yy;
+    }
+
+    // H = (I - rho s y') H (I - rho y s') + rho s s'
+    vector<PetscReal> hy(k);
+    for (size_t p = 0; p < pairs; ++p) {
+        s = &covariance->s[p * k];
+        y = &covariance->y[p * k];
+        sy = 0.0;
+        for (int i = 0; i < k; ++i) {
+            sy += s[i] * y[i];
+        }
+        PetscReal rho = 1.0 / sy, yhy = 0.0;
+        for (int i = 0; i < k; ++i) {
+            hy[i] = 0.0;
+            for (int j = 0; j < k; ++j) {
+                hy[i] += inverse[i * k + j] * y[j];
+            }
+            yhy += y[i] * hy[i];
+        }
+        for (int i = 0; i < k; ++i) {
+            for (int j = 0; j < k; ++j) {
+                inverse[i * k + j] += -rho * (s[i] * hy[j] + hy[i] * s[j]) + (rho * rho * yhy + rho) * s[i] * s[j];
+            }
+        }
+    }
+}
+
+// Direct evaluations at X, outside of the callbacks of the solve
+static PetscErrorCode covariance_residuals(Covariance *covariance, Problem *problem, Vec X, Vec R) {
+    PetscFunctionBegin;
+    if (problem->native != NULL) {
+        catch_error(evaluate_native(X, R, problem->native->sepfun, problem->native->data, problem->k,
+                                    covariance->residuals));
+    } else {
+        catch_error(evaluate_function(X, R, problem->objfun, problem->k, covariance->residuals));
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_objective(Covariance *covariance, Problem *problem, Vec X, Vec R, PetscReal *f) {
+    PetscFunctionBegin;
+    if (covariance->residuals > 0 && problem->objfun != NULL) {
+        catch_error(covariance_residuals(covariance, problem, X, R));
+        catch_error(VecDot(R, R, f));
+    } else if (problem->native != NULL) {
+        catch_error(evaluate_native(X, f, problem->native->objfun, problem->native->data, problem->k));
+    } else {
+        catch_error(evaluate_function(X, f, problem->objfun, problem->k));
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_gradient(Problem *problem, Vec X, Vec G) {
+    PetscReal f;
+    PetscFunctionBegin;
+    if (problem->native == NULL) {
+        catch_error(evaluate_function(X, G, problem->grafun, problem->k));
+    } else if (problem->native->grafun != NULL) {
+        catch_error(evaluate_native(X, G, problem->native->grafun, problem->native->data, problem->k, problem->k));
+    } else {
+        catch_error(evaluate_native(X, &f, G, problem->native->objgrad, problem->native->data, problem->k));
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_set(Vec X, const vector<PetscReal> &x) {
+    PetscReal *array;
+    PetscFunctionBegin;
+    catch_error(VecGetArray(X, &array));
+    std::copy(x.begin(), x.end(), array);
+    catch_error(VecRestoreArray(X, &array));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_get(Vec X, PetscReal *x) {
+    const PetscReal *array;
+    PetscInt size;
+    PetscFunctionBegin;
+    catch_error(VecGetLocalSize(X, &size));
+    catch_error(VecGetArrayRead(X, &array));
+    std::copy(array, array + size, x);
+    catch_error(VecRestoreArrayRead(X, &array));
+    PetscFunctionReturn(0);
+}
+
+// the step of central differences in parameter i
+static PetscReal covariance_step(const vector<PetscReal> &x, int i, double power) {
+    return pow(DBL_EPSILON, power) * std::max(1.0, fabs(x[i]));
+}
+
+// The Hessian from central differences of the gradient, or from four
+// evaluations of the objective function per pair of parameters
+static PetscErrorCode covariance_differences(Covariance *covariance, Problem *problem, const vector<PetscReal> &x0,
+                                             Vec X, Vec G, Vec R, PetscReal *hessian) {
+    int k = covariance->k;
+    vector<PetscReal> x(x0), plus(k), minus(k);
+
+    PetscFunctionBegin;
+    if (covariance->gradient) {
+        for (int i = 0; i < k; ++i) {
+            PetscReal h = covariance_step(x0, i, 1.0 / 3.0);
+            x[i] = x0[i] + h;
+            catch_error(covariance_set(X, x));
+            catch_error(covariance_gradient(problem, X, G));
+            catch_error(covariance_get(G, &plus[0]));
+            x[i] = x0[i] - h;
+            catch_error(covariance_set(X, x));
+            catch_error(covariance_gradient(problem, X, G));
+            catch_error(covariance_get(G, &minus[0]));
+            x[i] = x0[i];
+            for (int j = 0; j < k; ++j) {
+                hessian[i * k + j] = (plus[j] - minus[j]) / (2.0 * h);
+            }
+        }
+        for (int i = 0; i < k; ++i) {
+            for (int j = 0; j < i; ++j) {
+                hessian[i * k + j] = hessian[j * k + i] = 0.5 * (hessian[i * k + j] + hessian[j * k + i]);
+            }
+        }
+        PetscFunctionReturn(0);
+    }
+
+    PetscReal f[4];
+    for (int i = 0; i < k; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            PetscReal hi = covariance_step(x0, i, 0.25), hj = covariance_step(x0, j, 0.25);
+            for (int corner = 0; corner < 4; ++corner) {
+                x = x0;
+                x[i] += corner < 2 ? hi : -hi;
+                x[j] += corner % 2 == 0 ? hj : -hj;
+                catch_error(covariance_set(X, x));
+                catch_error(covariance_objective(covariance, problem, X, R, &f[corner]));
+            }
+            hessian[i * k + j] = hessian[j * k + i] = (f[0] - f[1] - f[2] + f[3]) / (4.0 * hi * hj);
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+// The Jacobian of the residuals from central differences, m x k column-major
+static PetscErrorCode covariance_jacobian(Covariance *covariance, Problem *problem, const vector<PetscReal> &x0,
+                                          Vec X, Vec R, PetscReal *jacobian) {
+    int k = covariance->k, m = covariance->residuals;
+    vector<PetscReal> x(x0), plus(m), minus(m);
+
+    PetscFunctionBegin;
+    for (int i = 0; i < k; ++i) {
+        PetscReal h = covariance_step(x0, i, 1.0 / 3.0);
+        x[i] = x0[i] + h;
+        catch_error(covariance_set(X, x));
+        catch_error(covariance_residuals(covariance, problem, X, R));
+        catch_error(covariance_get(R, &plus[0]));
+        x[i] = x0[i] - h;
+        catch_error(covariance_set(X, x));
+        catch_error(covariance_residuals(covariance, problem, X, R));
+        catch_error(covariance_get(R, &minus[0]));
+        x[i] = x0[i];
+        for (int r = 0; r < m; ++r) {
+            jacobian[(size_t) i * m + r] = (plus[r] - minus[r]) / (2.0 * h);
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_hessian(Problem *problem, Vec X, Mat H, PetscReal *hessian) {
+    int k = problem->k;
+    vector<PetscInt> index(k);
+    PetscFunctionBegin;
+    if (problem->native != NULL) {
+        catch_error(evaluate_native(X, H, problem->native->hesfun, problem->native->data, k));
+    } else {
+        catch_error(evaluate_function(X, H, problem->hesfun, k));
+    }
+    for (int i = 0; i < k; ++i) {
+        index[i] = i;
+    }
+    catch_error(MatGetValues(H, k, &index[0], k, &index[0], hessian));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode covariance_evaluate(Covariance *covariance, Problem *problem, const vector<PetscReal> &x,
+                                          Mat H, string *used, PetscReal *hessian, PetscReal *inverse,
+                                          PetscReal *meat, bool *has_meat, PetscReal *ssr) {
+
+    int k = covariance->k, m = covariance->residuals;
+    Vec X, G, R;
+    vector<PetscReal> jacobian((size_t) m * k), residuals(m);
+
+    PetscFunctionBegin;
+    catch_error(VecCreateSeq(PETSC_COMM_SELF, k, &X));
+    catch_error(VecCreateSeq(PETSC_COMM_SELF, k, &G));
+    catch_error(VecCreateSeq(PETSC_COMM_SELF, std::max(m, 1), &R));
+
+    // The residuals and their Jacobian at the solution
+    *ssr = 0.0;
+    if (m > 0) {
+        catch_error(covariance_jacobian(covariance, problem, x, X, R, &jacobian[0]));
+        catch_error(covariance_set(X, x));
+        catch_error(covariance_residuals(covariance, problem, X, R));
+        catch_error(covariance_get(R, &residuals[0]));
+        for (int r = 0; r < m; ++r) {
+            *ssr += residuals[r] * residuals[r];
+        }
+    }
+
+    string method = covariance->method;
+    if (method == "final") {
+        method = covariance->hessian ? "exact" : m > 0 ? "gn" : "fd";
+    } else if (method == "bfgs" && covariance->s.empty()) {
+        method = "fd";
+    }
+    if (method == "exact") {
+        catch_error(covariance_set(X, x));
+        catch_error(covariance_hessian(problem, X, H, hessian));
+    } else if (method == "bfgs") {
+        covariance_bfgs(covariance, inverse);
+    } else if (method == "gn") {
+        for (int a = 0; a < k; ++a) {
+            for (int b = 0; b < k; ++b) {
+                PetscReal sum = 0.0;
+                for (int r = 0; r < m; ++r) {
+                    sum += jacobian[(size_t) a * m + r] * jacobian[(size_t) b * m + r];
+                }
+                hessian[a * k + b] = 2.0 * sum;
+            }
+        }
+    } else {
+        catch_error(covariance_differences(covariance, problem, x, X, G, R, hessian));
+    }
+    *used = method;
+
+    // The meat of the sandwich: the gradients of the rows of a sum, or the
+    // gradients 2 r_i J_i of the squared residuals, but not of moment conditions
+    *has_meat = false;
+    if (sum_rows(problem->native) >= 0) {
+        catch_error(sum_outer_gradients(problem->native, k, &x[0], meat));
+        *has_meat = true;
+    } else if (m > 0 && !covariance->moments) {
+        std::fill(meat, meat + k * k, 0.0);
+        for (int r = 0; r < m; ++r) {
+            for (int a = 0; a < k; ++a) {
+                for (int b = 0; b < k; ++b) {
+                    meat[a * k + b] += 4.0 * residuals[r] * residuals[r] * jacobian[(size_t) a * m + r] *
+                                       jacobian[(size_t) b * m + r];
+                }
+            }
+        }
+        *has_meat = true;
+    }
+    catch_error(VecDestroy(&R));
+    catch_error(VecDestroy(&G));
+    catch_error(VecDestroy(&X));
+    PetscFunctionReturn(0);
+}
+
+List covariance_compute(Covariance *covariance, Problem *problem, NumericVector x, Mat H) {
+
+    int k = covariance->k;
+    string method;
+    bool has_meat;
+    PetscReal ssr;
+    NumericMatrix hessian(k, k), inverse(k, k), meat(k, k);
+
+    PetscErrorCode error_code = covariance_evaluate(covariance, problem, vector<PetscReal>(x.begin(), x.end()), H,
+                                                    &method, hessian.begin(), inverse.begin(), meat.begin(),
+                                                    &has_meat, &ssr);
+    if (error_code != 0) {
+        stop("the Hessian failed with PETSc error code %d.", error_code);
+    }
+    return List::create(
+        Named("method") = method,
+        Named("hessian") = method != "bfgs" ? (SEXP) hessian : R_NilValue,
+        Named("inverse") = method == "bfgs" ? (SEXP) inverse : R_NilValue,
+        Named("meat") = has_meat ? (SEXP) meat : R_NilValue,
+        Named("type") = covariance->moments ? "moments" : covariance->residuals > 0 ? "least squares" : "likelihood",
+        Named("residuals") = covariance->residuals,
+        Named("ssr") = covariance->residuals > 0 ? (SEXP) wrap(ssr) : R_NilValue
+    );
+}
+
+void covariance_destroy(Covariance *covariance) {
+    delete covariance;
+}
@@ -0,0 +1,70 @@
+#ifndef covariance_h
+#define covariance_h
+
+#include "taoR.h"
+
+// The curvature of the objective function at the solution, for standard
+// errors. Depending on the method, it is
+//
+//   "final": the Hessian, if the problem has one, or else as "gn" for
+//            least-squares problems, or else as "fd",
+//   "fd":    finite differences of the gradient, or of the objective
+//            function if there is no gradient,
+//   "gn":    the Gauss-Newton approximation 2 J'J from finite differences
+//            of the residuals of a least-squares problem,
+//   "bfgs":  the BFGS approximation of its inverse from the last steps and
+//            gradients of the solve, which is only as good as the path of
+//            the solver, or else as "fd" if the solve took no steps.
+//
+// For sums of terms, the outer products of the gradients of the rows are
+// added up as the meat of a sandwich covariance, and for least-squares
+// problems those of the gradients of the squared residuals. The residuals of
+// GMM and SMM objectives are moment conditions, which are neither independent
+// nor have a common variance, so these problems have no meat.
+struct Covariance {
+    string method;
+    int k;
+    int residuals;  // the number of residuals, 0 if the problem has none
+    bool moments;   // whether the residuals are moment conditions
+    bool gradient;
+    bool hessian;
+    vector<PetscReal> s, y;  // the last steps and changes of the gradient
+    vector<PetscReal> last_x, last_g;
+    bool has_last;
+};
+
+// Creates the curvature of a problem.
+//
+// @param method "final", "fd", "gn" or "bfgs".
+// @param problem The problem.
+// @param separable Whether the objective function is the sum of squares of
+//                  residuals.
+// @returns The curvature, to be released with covariance_destroy.
+Covariance *covariance_create(string method, Problem *problem, bool separable);
+
+// Records the step and the change of the gradient since the last iteration.
+// Called by the monitor.
+//
+// @param covariance The curvature, may be NULL.
+// @param tao_context The TAO context.
+// @returns Error code.
+PetscErrorCode covariance_record(Covariance *covariance, Tao tao_context);
+
+// Computes the curvature at the solution. The functions are evaluated
+// directly, without the budget, the trace or the replay of the solve.
+//
+// @param covariance The curvature.
+// @param problem The problem.
+// @param x The solution.
+// @param H A k x k matrix for the Hessian.
+// @returns A list with the method that was used ("exact", "bfgs", "fd" or
+//          "gn"), the hessian or its inverse, the meat of the sandwich if
+//          there is one, the type of the problem ("likelihood", "least
+//          squares" or "moments"), the number of residuals and the sum of
+//          their squares, if there are any.
+List covariance_compute(Covariance *covariance, Problem *problem, NumericVector x, Mat H);
+
+// Frees the curvature.
+void covariance_destroy(Covariance *covariance);
+
+#endif
@@ -0,0 +1,353 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <cmath>
+#include <string.h>
+#include "native.h"
+
+// Parametric curves m(t; x) fitted by weighted nonlinear least squares. The
+// residuals are sqrt(w_i) * (m(t_i; x) - y_i). Each curve computes its values
+// and its Jacobian, column-major with one row per data point, in loops over
+// the data points, and adds sum(c_i * hessian(m(t_i; x))) to a dense matrix.
+struct CurveShape {
+    int k;  // the number of parameters, or 0 for two per term
+    void (*values)(int k, const PetscReal *x, int n, const PetscReal *t, PetscReal *m, PetscReal *J);
+    void (*curvature)(int k, const PetscReal *x, int n, const PetscReal *t, const PetscReal *c, PetscReal *H);
+};
+
+// The exponential decay a * exp(-b t) + c
+static void exponential_values(int k, const PetscReal *x, int n, const PetscReal *t, PetscReal *m, PetscReal *J) {
+    for (int i = 0; i < n; ++i) {
+        PetscReal e = exp(-x[1] * t[i]);
+        m[i] = x[0] * e + x[2];
+        if (J != NULL) {
+            J[i] = e;
+            J[n + i] = -x[0] * t[i] * e;
+            J[2 * n + i] = 1.0;
+        }
+    }
+}
+
+static void exponential_curvature(int k, const PetscReal *x, int n, const PetscReal *t, const PetscReal *c, PetscReal *H) {
+    PetscReal ab = 0.0, bb = 0.0;
+    for (int i = 0; i < n; ++i) {
+        PetscReal e = c[i] * t[i] * exp(-x[1] * t[i]);
+        ab -= e;
+        bb += x[0] * t[i] * e;
+    }
+    H[1] += ab;
+    H[k] += ab;
+    H[k + 1] += bb;
+}
+
+// The logistic growth curve A / (1 + exp(-r (t - t0)))
+static void logistic_values(int k, const PetscReal *x, int n, const PetscReal *t, PetscReal *m, PetscReal *J) {
+    for (int i = 0; i < n; ++i) {
+        PetscReal u = t[i] - x[2];
+        PetscReal s = 1.0 / (1.0 + exp(-x[1] * u));
+        m[i] = x[0] * s;
+        if (J != NULL) {
+            PetscReal q = x[0] * s * (1.0 - s);
+            J[i] = s;
+            J[n + i] = q * u;
+            J[2 * n + i] = -q * x[1];
+        }
+    }
+}
+
+static void logistic_curvature(int k, const PetscReal *x, int n, const PetscReal *t, const PetscReal *c, PetscReal *H) {
+    PetscReal h[3][3] = {{0.0}};
+    for (int i = 0; i < n; ++i) {
+        PetscReal u = t[i] - x[2];
+        PetscReal s = 1.0 / (1.0 + exp(-x[1] * u));
+        PetscReal q = c[i] * s * (1.0 - s);
+        PetscReal d = x[0] * q * (1.0 - 2.0 * s);
+        h[0][1] += q * u;
+        h[0][2] -= q * x[1];
+        h[1][1] += d * u * u;
+        h[1][2] -= d * x[1] * u + x[0] * q;
+        h[2][2] += d * x[1] * x[1];
+    }
+    for (int a = 0; a < 3; ++a) {
+        for (int b = a; b < 3; ++b) {
+            H[a * k + b] += h[a][b];
+            if (a != b) {
+                H[b * k + a] += h[a][b];
+            }
+        }
+    }
+}
+
+// The Michaelis-Menten curve V t / (K + t)
+static void michaelis_menten_values(int k, const PetscReal *x, int n, const PetscReal *t, PetscReal *m, PetscReal *J) {
+    for (int i = 0; i < n; ++i) {
+        PetscReal s = t[i] / (x[1] + t[i]);
+        m[i] = x[0] * s;
+        if (J != NULL) {
+            J[i] = s;
+            J[n + i] = -x[0] * s / (x[1] + t[i]);
+        }
+    }
+}
+
+static void michaelis_menten_curvature(int k, const PetscReal *x, int n, const PetscReal *t, const PetscReal *c, PetscReal *H) {
+    PetscReal vk = 0.0, kk = 0.0;
+    for (int i = 0; i < n; ++i) {
+        PetscReal d = 1.0 / (x[1] + t[i]);
+        PetscReal e = c[i] * t[i] * d * d;
+        vk -= e;
+        kk += 2.0 * x[0] * e * d;
+    }
+    H[1] += vk;
+    H[k] += vk;
+    H[k + 1] += kk;
+}
+
+// The sum of exponentials a_1 exp(-b_1 t) + a_2 exp(-b_2 t) + ..., with
+// the parameters in pairs (a_j, b_j)
+static void exponentials_values(int k, const PetscReal *x, int n, const PetscReal *t, PetscReal *m, PetscReal *J) {
+    for (int i = 0; i < n; ++i) {
+        m[i] = 0.0;
+    }
+    for (int j = 0; j < k; j += 2) {
+        for (int i = 0; i < n; ++i) {
+            PetscReal e = exp(-x[j + 1] * t[i]);
+            m[i] += x[j] * e;
+            if (J != NULL) {
+                J[j * n + i] = e;
+                J[(j + 1) * n + i] = -x[j] * t[i] * e;
+            }
+        }
+    }
+}
+
+static void exponentials_curvature(int k, const PetscReal *x, int n, const PetscReal *t, const PetscReal *c, PetscReal *H) {
+    for (int j = 0; j < k; j += 2) {
+        PetscReal ab = 0.0, bb = 0.0;
+        for (int i = 0; i < n; ++i) {
+            PetscReal e = c[i] * t[i] * exp(-x[j + 1] * t[i]);
+            ab -= e;
+            bb += x[j] * t[i] * e;
+        }
+        H[j * k + j + 1] += ab;
+        H[(j + 1) * k + j] += ab;
+        H[(j + 1) * k + j + 1] += bb;
+    }
+}
+
+static const CurveShape EXPONENTIAL = {3, exponential_values, exponential_curvature};
+static const CurveShape LOGISTIC = {3, logistic_values, logistic_curvature};
+static const CurveShape MICHAELIS_MENTEN = {2, michaelis_menten_values, michaelis_menten_curvature};
+static const CurveShape EXPONENTIALS = {0, exponentials_values, exponentials_curvature};
+
+// A curve with its data. The residuals and the Jacobian of the last
+// parameters are kept, since the solvers ask for the objective function, the
+// gradient and the hessian at the same parameters.
+struct Curve {
+    const CurveShape *shape;
+    int k;
+    int n;
+    vector<PetscReal> t, y, scale;
+    vector<PetscReal> x, m, r, J;
+    bool has_residuals, has_jacobian;
+};
+
+static PetscErrorCode curve_update(int k, const PetscReal *x, bool jacobian, Curve *model) {
+    PetscFunctionBegin;
+    if (k != model->k) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", model->k, k);
+    }
+    if (model->has_residuals && memcmp(x, &model->x[0], k * sizeof(PetscReal)) == 0) {
+        if (model->has_jacobian || !jacobian) {
+            PetscFunctionReturn(0);
+        }
+    }
+    std::copy(x, x + k, model->x.begin());
+    int n = model->n;
+    model->shape->values(k, x, n, &model->t[0], &model->m[0], jacobian ? &model->J[0] : NULL);
+    for (int i = 0; i < n; ++i) {
+        model->r[i] = model->scale[i] * (model->m[i] - model->y[i]);
+    }
+    if (jacobian) {
+        for (int j = 0; j < k; ++j) {
+            PetscReal *column = &model->J[j * n];
+            for (int i = 0; i < n; ++i) {
+                column[i] *= model->scale[i];
+            }
+        }
+    }
+    model->has_residuals = true;
+    model->has_jacobian = jacobian;
+    PetscFunctionReturn(0);
+}
+
+static PetscReal curve_sum_of_squares(Curve *model) {
+    PetscReal f = 0.0;
+    for (int i = 0; i < model->n; ++i) {
+        f += model->r[i] * model->r[i];
+    }
+    return f;
+}
+
+// the gradient is 2 * J'r
+static void curve_gradient_of(Curve *model, PetscReal *g) {
+    int n = model->n;
+    for (int j = 0; j < model->k; ++j) {
+        const PetscReal *column = &model->J[j * n];
+        PetscReal sum = 0.0;
+        for (int i = 0; i < n; ++i) {
+            sum += column[i] * model->r[i];
+        }
+        g[j] = 2.0 * sum;
+    }
+}
+
+static PetscErrorCode curve_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    Curve *model = (Curve *) data;
+    PetscFunctionBegin;
+    catch_error(curve_update(k, x, false, model));
+    *f = curve_sum_of_squares(model);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode curve_separable(int k, const PetscReal *x, int n, PetscReal *y, void *data) {
+    Curve *model = (Curve *) data;
+    PetscFunctionBegin;
+    catch_error(curve_update(k, x, false, model));
+    std::copy(model->r.begin(), model->r.end(), y);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode curve_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    Curve *model = (Curve *) data;
+    PetscFunctionBegin;
+    catch_error(curve_update(k, x, true, model));
+    curve_gradient_of(model, g);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode curve_objective_gradient(int k, const PetscReal *x, PetscReal *f, PetscReal *g, void *data) {
+    Curve *model = (Curve *) data;
+    PetscFunctionBegin;
+    catch_error(curve_update(k, x, true, model));
+    *f = curve_sum_of_squares(model);
+    curve_gradient_of(model, g);
+    PetscFunctionReturn(0);
+}
+
+// the hessian is 2 * (J'J + sum(r_i * hessian(r_i)))
+static PetscErrorCode curve_hessian(int k, const PetscReal *x, int n, PetscReal *h, void *data) {
+    Curve *model = (Curve *) data;
+    PetscFunctionBegin;
+    catch_error(curve_update(k, x, true, model));
+    int points = model->n;
+    for (int a = 0; a < k; ++a) {
+        for (int b = 0; b <= a; ++b) {
+            const PetscReal *ja = &model->J[a * points], *jb = &model->J[b * points];
+            PetscReal sum = 0.0;
+            for (int i = 0; i < points; ++i) {
+                sum += ja[i] * jb[i];
+            }
+            h[a * k + b] = h[b * k + a] = sum;
+        }
+    }
+    vector<PetscReal> c(points);
+    for (int i = 0; i < points; ++i) {
+        c[i] = model->scale[i] * model->r[i];
+    }
+    model->shape->curvature(k, x, points, &model->t[0], &c[0], h);
+    for (int i = 0; i < k * k; ++i) {
+        h[i] *= 2.0;
+    }
+    PetscFunctionReturn(0);
+}
+
+static void curve_destroy(void *data) {
+    delete (Curve *) data;
+}
+
+static Native *create_curve(const CurveShape *shape, List data) {
+    Curve *model = new Curve();
+    model->shape = shape;
+    model->t = model_vector(data, "t");
+    model->y = model_vector(data, "y");
+    model->n = model->t.size();
+    model->k = shape->k > 0 ? shape->k : 2 * (data.containsElementNamed("terms") ? model_size(data, "terms") : 2);
+    if (model->n == 0 || (int) model->y.size() != model->n) {
+        delete model;
+        stop("t and y must have the same positive length.");
+    }
+    if (model->k < 2) {
+        delete model;
+        stop("a sum of exponentials requires at least one term.");
+    }
+    for (int i = 0; i < model->n; ++i) {
+        if (!std::isfinite(model->t[i]) || !std::isfinite(model->y[i])) {
+            delete model;
+            stop("t and y must be finite.");
+        }
+    }
+    model->scale.assign(model->n, 1.0);
+    if (data.containsElementNamed("weights")) {
+        vector<PetscReal> weights = model_vector(data, "weights");
+        if ((int) weights.size() != model->n) {
+            delete model;
+            stop("weights must have the same length as y.");
+        }
+        for (int i = 0; i < model->n; ++i) {
+            if (!(weights[i] >= 0) || !std::isfinite(weights[i])) {
+                delete model;
+                stop("weights must be finite and not negative.");
+            }
+            model->scale[i] = sqrt(weights[i]);
+        }
+    }
+    model->x.resize(model->k);
+    model->m.resize(model->n);
+    model->r.resize(model->n);
+    model->J.resize((size_t) model->n * model->k);
+
+    Native *native = new Native();
+    native->objfun = curve_objective;
+    native->grafun = curve_gradient;
+    native->hesfun = curve_hessian;
+    native->sepfun = curve_separable;
+    native->objgrad = curve_objective_gradient;
+    native->n = model->n;
+    native->data = model;
+    native->destroy = curve_destroy;
+    return native;
+}
+
+Native *create_exponential(List data) {
+    return create_curve(&EXPONENTIAL, data);
+}
+
+Native *create_logistic(List data) {
+    return create_curve(&LOGISTIC, data);
+}
+
+Native *create_michaelis_menten(List data) {
+    return create_curve(&MICHAELIS_MENTEN, data);
+}
+
+Native *create_exponentials(List data) {
+    return create_curve(&EXPONENTIALS, data);
+}
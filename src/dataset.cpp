@@ -0,0 +1,177 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dataset.h"
+
+static const char DATASET_MAGIC[8] = {'t', 'a', 'o', 'R', 'd', 'a', 't', '\0'};
+static const int32_t DATASET_VERSION = 1;
+static const uint64_t DATASET_ALIGNMENT = 4096;
+
+static uint64_t align(uint64_t offset) {
+    return (offset + DATASET_ALIGNMENT - 1) / DATASET_ALIGNMENT * DATASET_ALIGNMENT;
+}
+
+Dataset *dataset_open(string path) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(DatasetHeader)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    void *memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    Dataset *dataset = new Dataset();
+    dataset->fd = fd;
+    dataset->memory = memory;
+    dataset->size = info.st_size;
+
+    // Check that the header, the directory and all columns are in the file
+    const DatasetHeader *header = (const DatasetHeader *) memory;
+    const DatasetColumn *directory = (const DatasetColumn *) (header + 1);
+    bool valid = memcmp(header->magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) == 0
+                 && header->version == DATASET_VERSION && header->columns >= 0
+                 && sizeof(DatasetHeader) + header->columns * sizeof(DatasetColumn) <= dataset->size;
+    for (int c = 0; valid && c < header->columns; ++c) {
+        valid = directory[c].offset % sizeof(PetscReal) == 0
+                && directory[c].offset + header->rows * sizeof(PetscReal) <= dataset->size;
+        dataset->names.push_back(string(directory[c].name, strnlen(directory[c].name, sizeof(directory[c].name))));
+        dataset->columns.push_back((const PetscReal *) ((const char *) memory + directory[c].offset));
+    }
+    if (!valid) {
+        dataset_close(dataset);
+        return NULL;
+    }
+    dataset->rows = header->rows;
+    return dataset;
+}
+
+const PetscReal *dataset_column(Dataset *dataset, string name) {
+    for (size_t c = 0; c < dataset->names.size(); ++c) {
+        if (dataset->names[c] == name) {
+            return dataset->columns[c];
+        }
+    }
+    stop("the dataset has no column " + name + ".");
+}
+
+void dataset_close(Dataset *dataset) {
+    if (dataset == NULL) {
+        return;
+    }
+    munmap(dataset->memory, dataset->size);
+    close(dataset->fd);
+    delete dataset;
+}
+
+//' Write a dataset file
+//'
+//' @param path is the path of the file, which is replaced.
+//' @param columns is a named list of numeric vectors of the same length.
+// [[Rcpp::export]]
+void tao_dataset_write_cpp(String path, List columns) {
+
+    int count = columns.size();
+    CharacterVector names = columns.names();
+    DatasetHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.version = DATASET_VERSION;
+    header.columns = count;
+    header.rows = 0;
+    if (count > 0) {
+        NumericVector first = columns[0];
+        header.rows = first.size();
+    }
+
+    vector<DatasetColumn> directory(count);
+    uint64_t offset = align(sizeof(DatasetHeader) + count * sizeof(DatasetColumn));
+    for (int c = 0; c < count; ++c) {
+        string name = names[c];
+        if (name.size() >= sizeof(directory[c].name)) {
+            stop("the column name " + name + " is too long.");
+        }
+        NumericVector values = columns[c];
+        if ((uint64_t) values.size() != header.rows) {
+            stop("all columns must have the same length.");
+        }
+        memset(directory[c].name, 0, sizeof(directory[c].name));
+        memcpy(directory[c].name, name.c_str(), name.size());
+        directory[c].offset = offset;
+        offset = align(offset + header.rows * sizeof(PetscReal));
+    }
+
+    FILE *file = fopen(path.get_cstring(), "wb");
+    if (file == NULL) {
+        stop("cannot create dataset file.");
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                   && (count == 0 || fwrite(&directory[0], sizeof(DatasetColumn), count, file) == (size_t) count);
+    for (int c = 0; written && c < count; ++c) {
+        NumericVector values = columns[c];
+        written = fseek(file, directory[c].offset, SEEK_SET) == 0
+                  && fwrite(values.begin(), sizeof(PetscReal), header.rows, file) == header.rows;
+    }
+    if (fclose(file) != 0 || !written) {
+        stop("cannot write dataset file.");
+    }
+}
+
+static void dataset_finalizer(Dataset *dataset) {
+    dataset_close(dataset);
+}
+
+//' Map a dataset file
+//'
+//' @param path is the path of the file.
+//' @return an external pointer of class \code{tao_dataset_pointer}
+// [[Rcpp::export]]
+SEXP tao_dataset_open_cpp(String path) {
+    Dataset *dataset = dataset_open(path.get_cstring());
+    if (dataset == NULL) {
+        stop("cannot read dataset file.");
+    }
+    XPtr<Dataset, PreserveStorage, dataset_finalizer> ptr(dataset, true);
+    ptr.attr("class") = "tao_dataset_pointer";
+    return ptr;
+}
+
+//' Describe a dataset file
+//'
+//' @param dataset is an external pointer to a mapped dataset.
+//' @return a list with the number of rows and the names of the columns
+// [[Rcpp::export]]
+List tao_dataset_info_cpp(SEXP dataset) {
+    XPtr<Dataset> ptr(dataset);
+    return List::create(
+        Named("rows") = (double) ptr->rows,
+        Named("columns") = CharacterVector(ptr->names)
+    );
+}
@@ -0,0 +1,49 @@
+#ifndef dataset_h
+#define dataset_h
+
+#include "taoR.h"
+#include <stdint.h>
+
+// A dataset file holds a header, a directory with the name and the offset of
+// each column, and the columns as doubles, each starting on a page boundary.
+// It is mapped read-only, so that all processes that read the same file share
+// its pages, and only the pages that a solve touches are resident.
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t columns;
+    uint64_t rows;
+} DatasetHeader;
+
+typedef struct {
+    char name[56];
+    uint64_t offset;
+} DatasetColumn;
+
+// A mapped dataset file.
+struct Dataset {
+    int fd;
+    void *memory;
+    size_t size;
+    long rows;
+    vector<string> names;
+    vector<const PetscReal *> columns;
+};
+
+// Maps a dataset file.
+//
+// @param path The path of the file.
+// @returns The dataset or NULL if the file cannot be read.
+Dataset *dataset_open(string path);
+
+// Returns a column of a dataset, stops if it does not exist.
+//
+// @param dataset The dataset.
+// @param name The name of the column.
+// @returns The values of the column.
+const PetscReal *dataset_column(Dataset *dataset, string name);
+
+// Unmaps the file and frees the dataset.
+void dataset_close(Dataset *dataset);
+
+#endif
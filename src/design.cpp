@@ -0,0 +1,178 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <algorithm>
+#include "design.h"
+
+// the dot product of a column, NULL for ones, and v
+static PetscReal column_dot(const PetscReal *column, const PetscReal *v, long count) {
+    PetscReal sum = 0.0;
+    if (column == NULL) {
+        for (long r = 0; r < count; ++r) {
+            sum += v[r];
+        }
+    } else {
+        for (long r = 0; r < count; ++r) {
+            sum += column[r] * v[r];
+        }
+    }
+    return sum;
+}
+
+void design_read(SEXP X, Design &design) {
+
+    if (Rf_isS4(X) && Rf_inherits(X, "dgCMatrix")) {
+
+        // Transpose the compressed columns into compressed rows
+        S4 matrix(X);
+        IntegerVector dim = matrix.slot("Dim");
+        IntegerVector i = matrix.slot("i");
+        IntegerVector p = matrix.slot("p");
+        NumericVector x = matrix.slot("x");
+        design.rows = dim[0];
+        design.cols = dim[1];
+        design.sparse = true;
+        design.row_start.assign(design.rows + 1, 0);
+        for (int e = 0; e < i.size(); ++e) {
+            design.row_start[i[e] + 1]++;
+        }
+        for (long r = 0; r < design.rows; ++r) {
+            design.row_start[r + 1] += design.row_start[r];
+        }
+        vector<int> next(design.row_start.begin(), design.row_start.end() - 1);
+        design.column.resize(i.size());
+        design.value.resize(i.size());
+        for (int c = 0; c < design.cols; ++c) {
+            for (int e = p[c]; e < p[c + 1]; ++e) {
+                int position = next[i[e]]++;
+                design.column[position] = c;
+                design.value[position] = x[e];
+            }
+        }
+
+    } else if (Rf_isMatrix(X)) {
+
+        NumericMatrix matrix(X);
+        design.rows = matrix.nrow();
+        design.cols = matrix.ncol();
+        design.sparse = false;
+        design.dense.assign(matrix.begin(), matrix.end());
+        for (int c = 0; c < design.cols; ++c) {
+            design.columns.push_back(&design.dense[(size_t) c * design.rows]);
+        }
+
+    } else {
+        stop("X must be a numeric matrix or a sparse matrix of class dgCMatrix.");
+    }
+}
+
+void design_columns(const vector<const PetscReal *> &columns, long rows, Design &design) {
+    design.rows = rows;
+    design.cols = columns.size();
+    design.sparse = false;
+    design.columns = columns;
+}
+
+void design_multiply(const Design &design, const PetscReal *b, PetscReal *eta, long begin, long end) {
+
+    long count = end - begin;
+    if (design.sparse) {
+        for (long r = 0; r < count; ++r) {
+            PetscReal sum = 0.0;
+            for (int e = design.row_start[begin + r]; e < design.row_start[begin + r + 1]; ++e) {
+                sum += design.value[e] * b[design.column[e]];
+            }
+            eta[r] = sum;
+        }
+        return;
+    }
+
+    // Column by column, so that the inner loop runs over contiguous memory
+    std::fill(eta, eta + count, 0.0);
+    for (int c = 0; c < design.cols; ++c) {
+        PetscReal bc = b[c];
+        if (design.columns[c] == NULL) {
+            for (long r = 0; r < count; ++r) {
+                eta[r] += bc;
+            }
+            continue;
+        }
+        const PetscReal *column = design.columns[c] + begin;
+        for (long r = 0; r < count; ++r) {
+            eta[r] += column[r] * bc;
+        }
+    }
+}
+
+void design_transpose_multiply(const Design &design, const PetscReal *v, PetscReal *g, long begin, long end) {
+
+    long count = end - begin;
+    if (design.sparse) {
+        for (long r = 0; r < count; ++r) {
+            for (int e = design.row_start[begin + r]; e < design.row_start[begin + r + 1]; ++e) {
+                g[design.column[e]] += design.value[e] * v[r];
+            }
+        }
+        return;
+    }
+
+    for (int c = 0; c < design.cols; ++c) {
+        g[c] += column_dot(design.columns[c] != NULL ? design.columns[c] + begin : NULL, v, count);
+    }
+}
+
+void design_crossprod(const Design &design, const PetscReal *w, PetscReal *h, int ld, long begin, long end) {
+
+    long count = end - begin;
+    int cols = design.cols;
+    if (design.sparse) {
+        for (long r = 0; r < count; ++r) {
+            int first = design.row_start[begin + r], last = design.row_start[begin + r + 1];
+            for (int a = first; a < last; ++a) {
+                PetscReal wa = w[r] * design.value[a];
+                for (int b = first; b < last; ++b) {
+                    h[(size_t) design.column[b] * ld + design.column[a]] += wa * design.value[b];
+                }
+            }
+        }
+        return;
+    }
+
+    // The upper triangle, mirrored at the end
+    vector<PetscReal> weighted(count);
+    for (int b = 0; b < cols; ++b) {
+        const PetscReal *column_b = design.columns[b];
+        if (column_b == NULL) {
+            std::copy(w, w + count, weighted.begin());
+        } else {
+            for (long r = 0; r < count; ++r) {
+                weighted[r] = w[r] * column_b[begin + r];
+            }
+        }
+        for (int a = 0; a <= b; ++a) {
+            h[(size_t) b * ld + a] += column_dot(design.columns[a] != NULL ? design.columns[a] + begin : NULL,
+                                                 &weighted[0], count);
+        }
+    }
+    for (int b = 0; b < cols; ++b) {
+        for (int a = b + 1; a < cols; ++a) {
+            h[(size_t) b * ld + a] = h[(size_t) a * ld + b];
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef design_h
+#define design_h
+
+#include "taoR.h"
+
+// A design matrix with one row per observation, either dense with a pointer
+// to each column, or sparse with its nonzeros stored row by row. Dense
+// columns are read from R into dense or point into a mapped dataset; a NULL
+// column is a column of ones. All products work on a block of rows, with
+// the vectors of the block indexed from its first row, so that the rows can
+// be split between threads and streamed through the cache.
+struct Design {
+    long rows;
+    int cols;
+    bool sparse;
+    vector<const PetscReal *> columns;
+    vector<PetscReal> dense;
+    vector<int> row_start;
+    vector<int> column;
+    vector<PetscReal> value;
+};
+
+// Reads a design matrix from R, either a numeric matrix or a sparse matrix of
+// class dgCMatrix, stops otherwise.
+//
+// @param X The matrix.
+// @param design Receives the design matrix.
+void design_read(SEXP X, Design &design);
+
+// Sets up a dense design matrix from columns that are owned elsewhere.
+//
+// @param columns The columns, NULL for a column of ones.
+// @param rows The number of rows.
+// @param design Receives the design matrix.
+void design_columns(const vector<const PetscReal *> &columns, long rows, Design &design);
+
+// Computes eta = X b for the rows from begin to end.
+//
+// @param design The design matrix.
+// @param b The coefficients.
+// @param eta Receives the product of the rows.
+// @param begin The first row.
+// @param end One past the last row.
+void design_multiply(const Design &design, const PetscReal *b, PetscReal *eta, long begin, long end);
+
+// Adds X'v, restricted to the rows from begin to end, to g.
+//
+// @param design The design matrix.
+// @param v The weights of the rows.
+// @param g The column sums, incremented.
+// @param begin The first row.
+// @param end One past the last row.
+void design_transpose_multiply(const Design &design, const PetscReal *v, PetscReal *g, long begin, long end);
+
+// Adds X'diag(w)X, restricted to the rows from begin to end, to the upper
+// left corner of a column-major matrix.
+//
+// @param design The design matrix.
+// @param w The weights of the rows.
+// @param h The matrix, incremented.
+// @param ld The leading dimension of h.
+// @param begin The first row.
+// @param end One past the last row.
+void design_crossprod(const Design &design, const PetscReal *w, PetscReal *h, int ld, long begin, long end);
+
+#endif
@@ -18,43 +18,276 @@
 #include <taoR.h>
 #include "utils.h"
 #include "evaluate.h"
+#include "checkpoint.h"
+#include "budget.h"
+#include "logging.h"
+#include "latency.h"
+#include "trace.h"
+#include "replay.h"
+#include <petsctime.h>
+
+// this function looks up an evaluation in the checkpoint history
+static PetscErrorCode replay_evaluation(Problem *problem, int type, Vec X, PetscReal *y, bool *found) {
+    
+    const PetscReal *x;
+    LogEventScope log_event(TAOR_Replay);
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    *found = checkpoint_replay(problem->checkpoint, type, x, y);
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode replay_evaluation(Problem *problem, int type, Vec X, Vec Y, bool *found) {
+    
+    PetscReal *y;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArray(Y, &y));
+    catch_error(replay_evaluation(problem, type, X, y, found));
+    catch_error(VecRestoreArray(Y, &y));
+    PetscFunctionReturn(0);
+}
+
+// this function looks up an evaluation in the replayed trace
+static PetscErrorCode replay_recorded(Problem *problem, int type, Vec X, PetscReal *y, int count, bool *found) {
+    
+    const PetscReal *x;
+    LogEventScope log_event(TAOR_Replay);
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    *found = replay_lookup(problem->replay, type, x, y, count);
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode replay_recorded(Problem *problem, int type, Vec X, Vec Y, bool *found) {
+    
+    PetscReal *y;
+    PetscInt count;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetLocalSize(Y, &count));
+    catch_error(VecGetArray(Y, &y));
+    catch_error(replay_recorded(problem, type, X, y, count, found));
+    catch_error(VecRestoreArray(Y, &y));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode replay_recorded(Problem *problem, Vec X, PetscReal *f, Vec G, bool *found) {
+    
+    const PetscReal *x;
+    PetscReal *g;
+    LogEventScope log_event(TAOR_Replay);
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    catch_error(VecGetArray(G, &g));
+    *found = replay_lookup(problem->replay, x, f, g);
+    catch_error(VecRestoreArray(G, &g));
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+// this function adds an evaluation to the checkpoint history
+static PetscErrorCode record_evaluation(Problem *problem, int type, Vec X, const PetscReal *y) {
+    
+    const PetscReal *x;
+    LogEventScope log_event(TAOR_Record);
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    checkpoint_record(problem->checkpoint, type, x, y);
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode record_evaluation(Problem *problem, int type, Vec X, Vec Y) {
+    
+    const PetscReal *y;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(Y, &y));
+    catch_error(record_evaluation(problem, type, X, y));
+    catch_error(VecRestoreArrayRead(Y, &y));
+    PetscFunctionReturn(0);
+}
 
 // this function evaluates the separable objective function
 PetscErrorCode evaluate_objective_separable(Tao tao_context, Vec X, Vec F, void *ptr) {
     Problem *problem = (Problem *)ptr;
-    Function objfun = *(problem->objfun);
     int n = problem->n;
     int k = problem->k;
+    bool replayed = false;
+    bool recorded = false;
+    PetscLogDouble start;
+    double bytes = 0;
+    LogEventScope log_event(TAOR_Separable);
     
-    return evaluate_function(X, F, &objfun, k, n);
+    PetscFunctionBegin;
+    if (problem->checkpoint != NULL) {
+        catch_error(replay_evaluation(problem, CHECKPOINT_SEPARABLE, X, F, &replayed));
+    }
+    if (!replayed) {
+        catch_error(budget_spend(problem->budget, tao_context));
+        if (problem->replay != NULL) {
+            catch_error(replay_recorded(problem, TRACE_SEPARABLE, X, F, &recorded));
+        }
+        if (!recorded) {
+            catch_error(PetscTime(&start));
+            if (problem->native != NULL) {
+                catch_error(evaluate_native(X, F, problem->native->sepfun, problem->native->data, k, n));
+            } else {
+                catch_error(evaluate_function(X, F, problem->objfun, k, n));
+                bytes = (k + n) * sizeof(double);
+            }
+            catch_error(latency_record(&problem->latency->residual, start, bytes));
+        }
+        catch_error(trace_record(problem->trace, TRACE_SEPARABLE, X, F));
+        if (problem->checkpoint != NULL) {
+            catch_error(record_evaluation(problem, CHECKPOINT_SEPARABLE, X, F));
+        }
+    }
+    catch_error(budget_record(problem->budget, X, F));
+    PetscFunctionReturn(0);
 }
 
 // this function evaluates the objective function
 PetscErrorCode evaluate_objective(Tao tao_context, Vec X, PetscReal *f, void *ptr) {
     
     Problem *problem = (Problem *)ptr;
-    Function objfun = *(problem->objfun);
     int k = problem->k;
+    bool replayed = false;
+    bool recorded = false;
+    PetscLogDouble start;
+    double bytes = 0;
+    LogEventScope log_event(TAOR_Objective);
     
-    return evaluate_function(X, f, &objfun, k);
+    PetscFunctionBegin;
+    if (problem->checkpoint != NULL) {
+        catch_error(replay_evaluation(problem, CHECKPOINT_OBJECTIVE, X, f, &replayed));
+    }
+    if (!replayed) {
+        catch_error(budget_spend(problem->budget, tao_context));
+        if (problem->replay != NULL) {
+            catch_error(replay_recorded(problem, TRACE_OBJECTIVE, X, f, 1, &recorded));
+        }
+        if (!recorded) {
+            catch_error(PetscTime(&start));
+            if (problem->native != NULL) {
+                catch_error(evaluate_native(X, f, problem->native->objfun, problem->native->data, k));
+            } else {
+                catch_error(evaluate_function(X, f, problem->objfun, k));
+                bytes = (k + 1) * sizeof(double);
+            }
+            catch_error(latency_record(&problem->latency->objective, start, bytes));
+        }
+        catch_error(trace_record(problem->trace, TRACE_OBJECTIVE, X, f, 1));
+        if (problem->checkpoint != NULL) {
+            catch_error(record_evaluation(problem, CHECKPOINT_OBJECTIVE, X, f));
+        }
+    }
+    catch_error(budget_record(problem->budget, X, *f));
+    PetscFunctionReturn(0);
 }
 
 // this function evaluates the gradient
 PetscErrorCode evaluate_gradient(Tao tao_context, Vec X, Vec G, void *ptr) {
     Problem *problem = (Problem *)ptr;
-    Function grafun = *(problem->grafun);
     int k = problem->k;
+    bool replayed = false;
+    bool recorded = false;
+    PetscLogDouble start;
+    double bytes = 0;
+    LogEventScope log_event(TAOR_Gradient);
+    
+    PetscFunctionBegin;
+    if (problem->checkpoint != NULL) {
+        catch_error(replay_evaluation(problem, CHECKPOINT_GRADIENT, X, G, &replayed));
+    }
+    if (!replayed) {
+        catch_error(budget_spend(problem->budget, tao_context));
+        if (problem->replay != NULL) {
+            catch_error(replay_recorded(problem, TRACE_GRADIENT, X, G, &recorded));
+        }
+        if (!recorded) {
+            catch_error(PetscTime(&start));
+            if (problem->native != NULL) {
+                catch_error(evaluate_native(X, G, problem->native->grafun, problem->native->data, k, k));
+            } else {
+                catch_error(evaluate_function(X, G, problem->grafun, k));
+                bytes = 2 * k * sizeof(double);
+            }
+            catch_error(latency_record(&problem->latency->gradient, start, bytes));
+        }
+        catch_error(trace_record(problem->trace, TRACE_GRADIENT, X, G));
+        if (problem->checkpoint != NULL) {
+            catch_error(record_evaluation(problem, CHECKPOINT_GRADIENT, X, G));
+        }
+    }
+    PetscFunctionReturn(0);
+}
 
-    return evaluate_function(X, G, &grafun, k);
+// this function evaluates the objective function and the gradient together,
+// they are replayed and recorded as two evaluations but spend one
+PetscErrorCode evaluate_objective_gradient(Tao tao_context, Vec X, PetscReal *f, Vec G, void *ptr) {
+    Problem *problem = (Problem *)ptr;
+    int k = problem->k;
+    bool replayed = false;
+    bool recorded = false;
+    PetscLogDouble start;
+    LogEventScope log_event(TAOR_Objective);
+    
+    PetscFunctionBegin;
+    if (problem->checkpoint != NULL) {
+        catch_error(replay_evaluation(problem, CHECKPOINT_OBJECTIVE, X, f, &replayed));
+        if (replayed) {
+            catch_error(replay_evaluation(problem, CHECKPOINT_GRADIENT, X, G, &replayed));
+        }
+    }
+    if (!replayed) {
+        catch_error(budget_spend(problem->budget, tao_context));
+        if (problem->replay != NULL) {
+            catch_error(replay_recorded(problem, X, f, G, &recorded));
+        }
+        if (!recorded) {
+            catch_error(PetscTime(&start));
+            catch_error(evaluate_native(X, f, G, problem->native->objgrad, problem->native->data, k));
+            catch_error(latency_record(&problem->latency->objective_gradient, start, 0));
+        }
+        catch_error(trace_record(problem->trace, TRACE_OBJECTIVE, X, f, 1));
+        catch_error(trace_record(problem->trace, TRACE_GRADIENT, X, G));
+        if (problem->checkpoint != NULL) {
+            catch_error(record_evaluation(problem, CHECKPOINT_OBJECTIVE, X, f));
+            catch_error(record_evaluation(problem, CHECKPOINT_GRADIENT, X, G));
+        }
+    }
+    catch_error(budget_record(problem->budget, X, *f));
+    PetscFunctionReturn(0);
 }
 
 // this function evaluates the hessian
 PetscErrorCode evaluate_hessian(Tao tao_context, Vec X, Mat H, Mat Hpre, void *ptr) {
     Problem *problem = (Problem *)ptr;
-    Function hesfun = *(problem->hesfun);
     int k = problem->k;
+    PetscLogDouble start;
+    double bytes = 0;
+    LogEventScope log_event(TAOR_Hessian);
     
-    return evaluate_function(X, H, &hesfun, k);
+    PetscFunctionBegin;
+    catch_error(budget_spend(problem->budget, tao_context));
+    catch_error(PetscTime(&start));
+    if (problem->native != NULL) {
+        catch_error(evaluate_native(X, H, problem->native->hesfun, problem->native->data, k));
+    } else {
+        catch_error(evaluate_function(X, H, problem->hesfun, k));
+        bytes = (k + k * k) * sizeof(double);
+    }
+    catch_error(latency_record(&problem->latency->hessian, start, bytes));
+    catch_error(trace_record(problem->trace, TRACE_HESSIAN, X, NULL, 0));
+    PetscFunctionReturn(0);
 }
 
 /*
@@ -77,6 +310,32 @@ PetscErrorCode evaluate_equalities(Tao tao_context, Vec X, Vec Ci, void *ptr) {
     return evaluate_function(X, Ci, &equal, k);
 }
 */
+
+// this function registers the callbacks of the problem with the solver
+PetscErrorCode set_callbacks(Tao tao_context, Problem *problem, bool separable, Vec F, Mat H) {
+    
+    PetscFunctionBegin;
+    if (separable) {
+        catch_error(TaoSetSeparableObjectiveRoutine(tao_context, F, evaluate_objective_separable, (void*)problem));
+    } else {
+        catch_error(TaoSetObjectiveRoutine(tao_context, evaluate_objective, (void*)problem));
+    }
+    
+    if (problem->grafun != NULL || (problem->native != NULL && problem->native->grafun != NULL)) {
+        catch_error(TaoSetGradientRoutine(tao_context, evaluate_gradient, (void*)problem));
+    }
+    
+    // Solvers that need both at the same point get them in one pass
+    if (!separable && problem->native != NULL && problem->native->objgrad != NULL) {
+        catch_error(TaoSetObjectiveAndGradientRoutine(tao_context, evaluate_objective_gradient, (void*)problem));
+    }
+    
+    if (problem->hesfun != NULL || (problem->native != NULL && problem->native->hesfun != NULL)) {
+        catch_error(TaoSetHessianRoutine(tao_context, H, H, evaluate_hessian, (void*)problem));
+    }
+    PetscFunctionReturn(0);
+}
+
 // this function set the starting value
 PetscErrorCode create_vec(Vec X, NumericVector y) {
     
@@ -31,6 +31,17 @@ PetscErrorCode evaluate_objective(Tao tao_context, Vec X, PetscReal *f, void *pt
 // @return Error code.
 PetscErrorCode evaluate_gradient(Tao tao_context, Vec X, Vec G, void *ptr);
 
+// Evaluates the objective function and its gradient in one pass. Only
+// registered for native objectives that provide both at once.
+//
+// @param tao_context The tao context.
+// @param X The parameter values to evaluate the function at.
+// @param f The location to write the value of the objective function.
+// @param G The vector to write the gradient to.
+// @param ptr User-defined problem context.
+// @return Error code.
+PetscErrorCode evaluate_objective_gradient(Tao tao_context, Vec X, PetscReal *f, Vec G, void *ptr);
+
 // Evaluates the Hessian matrix.
 //
 // @param tao_context The tao context.
@@ -60,6 +71,18 @@ PetscErrorCode evaluate_inequalities(Tao tao_context, Vec X, Vec Ci, void *ptr);
 // @return Error code.
 PetscErrorCode evaluate_equalities(Tao tao_context, Vec X, Vec Ci, void *ptr);
 
+// Registers the objective, gradient and Hessian callbacks of a problem with
+// a TAO solver. The gradient and Hessian are only registered if the problem
+// context provides them.
+//
+// @param tao_context The tao context.
+// @param problem User-defined problem context.
+// @param separable Whether to register the separable objective (Pounders).
+// @param F The vector for the separable objective.
+// @param H The matrix for the Hessian.
+// @return Error code.
+PetscErrorCode set_callbacks(Tao tao_context, Problem *problem, bool separable, Vec F, Mat H);
+
 // Initializes a new PETSc vector from an Rcpp NumericVector.
 //
 // @param X The vector to initialize..
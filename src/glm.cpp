@@ -0,0 +1,303 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include "native.h"
+#include "design.h"
+#include "sum.h"
+#include "dataset.h"
+
+// The families of generalized linear models
+enum {
+    GLM_LOGIT = 0,
+    GLM_PROBIT = 1,
+    GLM_POISSON = 2,
+    GLM_NEGBIN = 3
+};
+
+static const char *FAMILY_NAMES[] = {"logit", "probit", "poisson", "negbin"};
+
+// The negative log-likelihood of a generalized linear model with linear
+// predictor eta = X b + offset and weighted observations, as a sum of terms
+// over the rows of X. The negative binomial model has log(theta) as its last
+// parameter. The data are either read from R or columns of a mapped dataset;
+// weights and offset may be NULL. The kernels keep the linear predictor and
+// the derivatives of a block of rows in buffers of their own.
+struct Glm {
+    int family;
+    Design X;
+    const PetscReal *y, *weights, *offset;
+    vector<PetscReal> storage[3];
+    RObject dataset;
+};
+
+// the linear predictor of the rows from begin to end
+static void glm_predict(Glm *model, const PetscReal *x, long begin, long end, PetscReal *eta) {
+    design_multiply(model->X, x, eta, begin, end);
+    if (model->offset != NULL) {
+        for (long r = 0; r < end - begin; ++r) {
+            eta[r] += model->offset[begin + r];
+        }
+    }
+}
+
+// The kernels run on the threads of the pool and must not call R, not even
+// the functions of Rmath, which may warn through R. The special functions
+// below stand in for them.
+
+// the log of the standard normal distribution function, with the asymptotic
+// series in the far lower tail where erfc underflows
+static PetscReal log_pnorm(PetscReal t) {
+    if (t > 0.0) {
+        return log1p(-0.5 * erfc(t * M_SQRT1_2));
+    }
+    if (t > -30.0) {
+        return log(0.5 * erfc(-t * M_SQRT1_2));
+    }
+    PetscReal u = 1.0 / (t * t);
+    return -0.5 * t * t - 0.5 * log(2.0 * M_PI) - log(-t) + log1p(-u * (1.0 - 3.0 * u * (1.0 - 5.0 * u)));
+}
+
+// the inverse Mills ratio dnorm(t) / pnorm(t)
+static PetscReal mills(PetscReal t) {
+    return exp(-0.5 * t * t - 0.5 * log(2.0 * M_PI) - log_pnorm(t));
+}
+
+// the digamma function for positive arguments, from the recurrence and the
+// asymptotic series
+static PetscReal digamma(PetscReal x) {
+    PetscReal result = 0.0;
+    for (; x < 10.0; x += 1.0) {
+        result -= 1.0 / x;
+    }
+    PetscReal f = 1.0 / (x * x);
+    return result + log(x) - 0.5 / x
+           - f * (1.0 / 12 - f * (1.0 / 120 - f * (1.0 / 252 - f * (1.0 / 240 - f / 132))));
+}
+
+// the trigamma function for positive arguments
+static PetscReal trigamma(PetscReal x) {
+    PetscReal result = 0.0;
+    for (; x < 10.0; x += 1.0) {
+        result += 1.0 / (x * x);
+    }
+    PetscReal t = 1.0 / x, f = t * t;
+    return result + t + 0.5 * f + t * f * (1.0 / 6 - f * (1.0 / 30 - f * (1.0 / 42 - f / 30)));
+}
+
+// the log-likelihood of an observation and its derivatives by eta and by the
+// log of the dispersion theta
+static PetscReal glm_term(int family, PetscReal y, PetscReal eta, PetscReal theta,
+                          PetscReal *score, PetscReal *score_alpha) {
+    switch (family) {
+    case GLM_LOGIT: {
+        PetscReal mu = 1.0 / (1.0 + exp(-eta));
+        *score = y - mu;
+        return y * eta - (eta > 0 ? eta + log1p(exp(-eta)) : log1p(exp(eta)));
+    }
+    case GLM_PROBIT:
+        *score = y * mills(eta) - (1.0 - y) * mills(-eta);
+        return y * log_pnorm(eta) + (1.0 - y) * log_pnorm(-eta);
+    case GLM_POISSON: {
+        PetscReal mu = exp(eta);
+        *score = y - mu;
+        return y * eta - mu - std::lgamma(y + 1.0);
+    }
+    default: {
+        PetscReal mu = exp(eta);
+        *score = theta * (y - mu) / (theta + mu);
+        *score_alpha = theta * (digamma(y + theta) - digamma(theta) + log(theta) + 1.0
+                                - log(theta + mu) - (y + theta) / (theta + mu));
+        return std::lgamma(y + theta) - std::lgamma(theta) - std::lgamma(y + 1.0)
+               + theta * (log(theta) - log(theta + mu)) + y * (eta - log(theta + mu));
+    }
+    }
+}
+
+// the negative second derivatives of the log-likelihood of an observation by
+// eta, by eta and the log of theta, and by the log of theta
+static PetscReal glm_curvature(int family, PetscReal y, PetscReal eta, PetscReal theta,
+                               PetscReal *cross, PetscReal *curvature_alpha) {
+    switch (family) {
+    case GLM_LOGIT: {
+        PetscReal mu = 1.0 / (1.0 + exp(-eta));
+        return mu * (1.0 - mu);
+    }
+    case GLM_PROBIT: {
+        PetscReal m1 = mills(eta), m0 = mills(-eta);
+        return y * m1 * (eta + m1) + (1.0 - y) * m0 * (m0 - eta);
+    }
+    case GLM_POISSON:
+        return exp(eta);
+    default: {
+        PetscReal mu = exp(eta);
+        PetscReal s = theta + mu;
+        PetscReal score_theta = digamma(y + theta) - digamma(theta) + log(theta) + 1.0 - log(s) - (y + theta) / s;
+        PetscReal curvature_theta = trigamma(y + theta) - trigamma(theta) + 1.0 / theta - 2.0 / s + (y + theta) / (s * s);
+        *cross = -theta * (y - mu) * mu / (s * s);
+        *curvature_alpha = -(theta * theta * curvature_theta + theta * score_theta);
+        return (y + theta) * theta * mu / (s * s);
+    }
+    }
+}
+
+static int glm_terms(int k, const PetscReal *x, long begin, long end, PetscReal *f, PetscReal *g, void *data) {
+
+    Glm *model = (Glm *) data;
+    long count = end - begin;
+    vector<PetscReal> eta(count), score(count);
+    PetscReal theta = model->family == GLM_NEGBIN ? exp(x[k - 1]) : 0.0;
+    PetscReal sum = 0.0, score_alpha = 0.0;
+    glm_predict(model, x, begin, end, &eta[0]);
+    for (long r = 0; r < count; ++r) {
+        PetscReal weight = model->weights != NULL ? model->weights[begin + r] : 1.0;
+        PetscReal s, alpha = 0.0;
+        sum -= weight * glm_term(model->family, model->y[begin + r], eta[r], theta, &s, &alpha);
+        score[r] = -weight * s;
+        score_alpha -= weight * alpha;
+    }
+    *f += sum;
+    if (g != NULL) {
+        design_transpose_multiply(model->X, &score[0], g, begin, end);
+        if (model->family == GLM_NEGBIN) {
+            g[k - 1] += score_alpha;
+        }
+    }
+    return 0;
+}
+
+static int glm_hessian_terms(int k, const PetscReal *x, long begin, long end, PetscReal *h, void *data) {
+
+    Glm *model = (Glm *) data;
+    long count = end - begin;
+    int p = model->X.cols;
+    vector<PetscReal> eta(count), curvature(count), cross(count);
+    PetscReal theta = model->family == GLM_NEGBIN ? exp(x[k - 1]) : 0.0;
+    PetscReal curvature_alpha = 0.0;
+    glm_predict(model, x, begin, end, &eta[0]);
+    for (long r = 0; r < count; ++r) {
+        PetscReal weight = model->weights != NULL ? model->weights[begin + r] : 1.0;
+        PetscReal c = 0.0, alpha = 0.0;
+        curvature[r] = weight * glm_curvature(model->family, model->y[begin + r], eta[r], theta, &c, &alpha);
+        cross[r] = weight * c;
+        curvature_alpha += weight * alpha;
+    }
+
+    design_crossprod(model->X, &curvature[0], h, k, begin, end);
+    if (model->family == GLM_NEGBIN) {
+        vector<PetscReal> column(p, 0.0);
+        design_transpose_multiply(model->X, &cross[0], &column[0], begin, end);
+        for (int j = 0; j < p; ++j) {
+            h[(size_t) p * k + j] += column[j];
+            h[(size_t) j * k + p] += column[j];
+        }
+        h[(size_t) p * k + p] += curvature_alpha;
+    }
+    return 0;
+}
+
+static void glm_destroy(void *data) {
+    delete (Glm *) data;
+}
+
+// reads a vector with one element per observation, either from R or as the
+// name of a column of the dataset; returns NULL if it is optional and missing
+static const PetscReal *glm_vector(List data, const char *name, Glm *model, int slot, bool required) {
+    if (!data.containsElementNamed(name) || Rf_isNull(data[name])) {
+        if (required) {
+            stop(string("model data must contain ") + name + ".");
+        }
+        return NULL;
+    }
+    if (model->dataset != R_NilValue && TYPEOF(data[name]) == STRSXP) {
+        return dataset_column(XPtr<Dataset>(model->dataset).get(), as<string>(data[name]));
+    }
+    model->storage[slot] = model_vector(data, name);
+    if ((long) model->storage[slot].size() != model->X.rows) {
+        stop(string(name) + " must have one element per row of X.");
+    }
+    return &model->storage[slot][0];
+}
+
+// reads the columns of the design matrix from the dataset, "1" is a column
+// of ones
+static void glm_dataset_design(List data, Glm *model) {
+    Dataset *dataset = XPtr<Dataset>(model->dataset).get();
+    CharacterVector names = data["X"];
+    vector<const PetscReal *> columns;
+    for (int c = 0; c < names.size(); ++c) {
+        string name = names[c];
+        columns.push_back(name == "1" ? NULL : dataset_column(dataset, name));
+    }
+    design_columns(columns, dataset->rows, model->X);
+}
+
+Native *create_glm(List data) {
+
+    if (!data.containsElementNamed("family") || !data.containsElementNamed("X")) {
+        stop("model data must contain family and X.");
+    }
+    string family = as<string>(data["family"]);
+    int index = -1;
+    for (int i = 0; i < 4; ++i) {
+        if (family == FAMILY_NAMES[i]) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        stop("unknown family " + family + ".");
+    }
+
+    // The model is freed by the unique pointer if the data are invalid
+    std::unique_ptr<Glm> model(new Glm());
+    model->family = index;
+    if (data.containsElementNamed("data")) {
+        SEXP dataset = data["data"];
+        model->dataset = dataset;
+        if (!Rf_inherits(model->dataset, "tao_dataset_pointer")) {
+            stop("data must be a dataset, see tao_dataset.");
+        }
+        glm_dataset_design(data, model.get());
+    } else {
+        design_read(data["X"], model->X);
+    }
+    model->y = glm_vector(data, "y", model.get(), 0, true);
+    model->weights = glm_vector(data, "weights", model.get(), 1, false);
+    model->offset = glm_vector(data, "offset", model.get(), 2, false);
+    for (long r = 0; r < model->X.rows; ++r) {
+        PetscReal y = model->y[r];
+        if (!(y >= 0) || ((index == GLM_LOGIT || index == GLM_PROBIT) && y > 1)) {
+            stop("y must be in [0, 1] for family " + family + " and nonnegative otherwise.");
+        }
+    }
+
+    NativeSum sum = NativeSum();
+    sum.terms = glm_terms;
+    sum.hesterms = glm_hessian_terms;
+    sum.rows = model->X.rows;
+    sum.k = model->X.cols + (index == GLM_NEGBIN ? 1 : 0);
+    sum.data = model.get();
+    sum.destroy = glm_destroy;
+    int threads = data.containsElementNamed("threads") ? as<int>(data["threads"]) : 1;
+    model.release();
+    return sum_create(sum, R_NilValue, threads);
+}
@@ -0,0 +1,116 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <algorithm>
+#include "history.h"
+
+// the history holds at most this many iterations
+static const PetscInt MAX_CAPACITY = 10000;
+
+PetscErrorCode history_create(History **history_out, Tao tao_context, int k) {
+
+    PetscInt max_it;
+
+    PetscFunctionBegin;
+    catch_error(TaoGetMaximumIterations(tao_context, &max_it));
+
+    History *history = new History();
+    history->capacity = std::min(std::max(max_it + 1, (PetscInt) 1), MAX_CAPACITY);
+    history->count = 0;
+    history->f.resize(history->capacity);
+    history->gnorm.resize(history->capacity);
+    history->cnorm.resize(history->capacity);
+    history->lits.resize(history->capacity);
+    history->iteration.resize(history->capacity);
+    history->xdiff.resize(history->capacity);
+    history->step.resize(history->capacity);
+    history->evaluations.resize(history->capacity);
+    history->elapsed.resize(history->capacity);
+    history->previous.resize(k);
+
+    // TAO starts a new history with every solve
+    catch_error(TaoSetConvergenceHistory(tao_context, &history->f[0], &history->gnorm[0], &history->cnorm[0],
+                                         &history->lits[0], history->capacity, PETSC_TRUE));
+    *history_out = history;
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode history_record(History *history, Tao tao_context, double evaluations, double elapsed) {
+
+    PetscInt its;
+    PetscReal step;
+    Vec X;
+    const PetscReal *x;
+
+    PetscFunctionBegin;
+    if (history == NULL) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(TaoGetSolutionStatus(tao_context, &its, 0, 0, 0, &step, 0));
+    if (its == 0) {
+        history->count = 0;
+    }
+    if (history->count >= history->capacity) {
+        PetscFunctionReturn(0);
+    }
+
+    // The change in the iterate since the last iteration
+    catch_error(TaoGetSolutionVector(tao_context, &X));
+    catch_error(VecGetArrayRead(X, &x));
+    PetscReal xdiff = 0;
+    int k = history->previous.size();
+    if (history->count > 0) {
+        for (int i = 0; i < k; ++i) {
+            xdiff += (x[i] - history->previous[i]) * (x[i] - history->previous[i]);
+        }
+    }
+    std::copy(x, x + k, history->previous.begin());
+    catch_error(VecRestoreArrayRead(X, &x));
+
+    int row = history->count++;
+    history->iteration[row] = its;
+    history->xdiff[row] = sqrt(xdiff);
+    history->step[row] = step;
+    history->evaluations[row] = evaluations;
+    history->elapsed[row] = elapsed;
+    PetscFunctionReturn(0);
+}
+
+DataFrame history_read(History *history, Tao tao_context) {
+
+    PetscReal *f, *gnorm, *cnorm;
+    PetscInt *lits, length;
+
+    TaoGetConvergenceHistory(tao_context, &f, &gnorm, &cnorm, &lits, &length);
+    int rows = std::min((int) length, history->count);
+
+    return DataFrame::create(
+        Named("iteration") = IntegerVector(history->iteration.begin(), history->iteration.begin() + rows),
+        Named("f") = NumericVector(f, f + rows),
+        Named("gnorm") = NumericVector(gnorm, gnorm + rows),
+        Named("cnorm") = NumericVector(cnorm, cnorm + rows),
+        Named("xdiff") = NumericVector(history->xdiff.begin(), history->xdiff.begin() + rows),
+        Named("step") = NumericVector(history->step.begin(), history->step.begin() + rows),
+        Named("evals") = NumericVector(history->evaluations.begin(), history->evaluations.begin() + rows),
+        Named("elapsed") = NumericVector(history->elapsed.begin(), history->elapsed.begin() + rows)
+    );
+}
+
+void history_destroy(History *history) {
+    delete history;
+}
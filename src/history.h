@@ -0,0 +1,51 @@
+#ifndef history_h
+#define history_h
+
+#include "taoR.h"
+
+// The convergence history of a solve. TAO records the objective function
+// value, the gradient norm and the constraint norm of every iteration through
+// TaoSetConvergenceHistory; the monitor adds the change in the iterate, the
+// step length, the number of evaluations and the elapsed time. All arrays are
+// allocated up front, and iterations beyond their capacity are not recorded.
+struct History {
+    int capacity;
+    int count;
+    vector<PetscReal> f, gnorm, cnorm;
+    vector<PetscInt> lits;
+    vector<int> iteration;
+    vector<double> xdiff, step, evaluations, elapsed;
+    vector<PetscReal> previous;
+};
+
+// Creates a history and registers it with the solver. Call me after the
+// maximum number of iterations is set.
+//
+// @param history Receives the new history.
+// @param tao_context The TAO context.
+// @param k The number of parameters.
+// @returns Error code.
+PetscErrorCode history_create(History **history, Tao tao_context, int k);
+
+// Records the current iteration. Called by the monitor, a new solve starts
+// a new history.
+//
+// @param history The history, may be NULL.
+// @param tao_context The TAO context.
+// @param evaluations The number of evaluations so far.
+// @param elapsed The time since the solve started in seconds.
+// @returns Error code.
+PetscErrorCode history_record(History *history, Tao tao_context, double evaluations, double elapsed);
+
+// Returns the history as a data frame with the columns iteration, f, gnorm,
+// cnorm, xdiff, step, evals and elapsed.
+//
+// @param history The history.
+// @param tao_context The TAO context.
+// @returns The data frame.
+DataFrame history_read(History *history, Tao tao_context);
+
+// Frees the history.
+void history_destroy(History *history);
+
+#endif
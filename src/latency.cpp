@@ -0,0 +1,100 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <petsctime.h>
+#include <math.h>
+#include <algorithm>
+#include "latency.h"
+
+Latency *latency_create() {
+    return new Latency();
+}
+
+PetscErrorCode latency_record(LatencyHistogram *histogram, PetscLogDouble start, double bytes) {
+
+    PetscLogDouble now;
+    int exponent;
+
+    PetscFunctionBegin;
+    catch_error(PetscTime(&now));
+    PetscLogDouble elapsed = now - start;
+
+    // The exponent of the latency in microseconds is its bucket
+    frexp(elapsed * 1e6, &exponent);
+    int bucket = std::min(std::max(exponent, 0), LATENCY_BUCKETS - 1);
+
+    histogram->calls++;
+    histogram->total += elapsed;
+    histogram->max = std::max(histogram->max, elapsed);
+    histogram->bytes += bytes;
+    histogram->buckets[bucket]++;
+    PetscFunctionReturn(0);
+}
+
+// the upper edge of the bucket that holds the given quantile
+static double quantile(const LatencyHistogram &histogram, double q) {
+    if (histogram.calls == 0) {
+        return NA_REAL;
+    }
+    long rank = (long) ceil(q * histogram.calls);
+    long seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS - 1; ++i) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            return std::min(ldexp(1.0, i) * 1e-6, histogram.max);
+        }
+    }
+    return histogram.max;
+}
+
+DataFrame latency_read(Latency *latency) {
+
+    const char *names[] = {"objective", "gradient", "hessian", "residual", "objective_gradient"};
+    const LatencyHistogram *histograms[] = {&latency->objective, &latency->gradient,
+                                            &latency->hessian, &latency->residual,
+                                            &latency->objective_gradient};
+    CharacterVector callback(5);
+    NumericVector calls(5), total(5), p50(5), p99(5), max(5), bytes(5);
+
+    for (int i = 0; i < 5; ++i) {
+        const LatencyHistogram &histogram = *histograms[i];
+        callback[i] = names[i];
+        calls[i] = histogram.calls;
+        total[i] = histogram.total;
+        p50[i] = quantile(histogram, 0.5);
+        p99[i] = quantile(histogram, 0.99);
+        max[i] = histogram.calls > 0 ? histogram.max : NA_REAL;
+        bytes[i] = histogram.bytes;
+    }
+
+    return DataFrame::create(
+        Named("callback") = callback,
+        Named("calls") = calls,
+        Named("total") = total,
+        Named("p50") = p50,
+        Named("p99") = p99,
+        Named("max") = max,
+        Named("bytes") = bytes,
+        Named("stringsAsFactors") = false
+    );
+}
+
+void latency_destroy(Latency *latency) {
+    delete latency;
+}
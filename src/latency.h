@@ -0,0 +1,53 @@
+#ifndef latency_h
+#define latency_h
+
+#include "taoR.h"
+
+// Number of buckets of a latency histogram. Bucket i holds the calls that
+// took between 2^(i-1) and 2^i microseconds, the last bucket all longer calls.
+#define LATENCY_BUCKETS 40
+
+// Calls of one callback: their number, a histogram of their latency, and the
+// bytes copied between PETSc and R.
+struct LatencyHistogram {
+    long calls;
+    PetscLogDouble total;
+    PetscLogDouble max;
+    double bytes;
+    long buckets[LATENCY_BUCKETS];
+};
+
+// The callbacks of a solve. Replayed evaluations are not counted.
+struct Latency {
+    LatencyHistogram objective;
+    LatencyHistogram gradient;
+    LatencyHistogram hessian;
+    LatencyHistogram residual;
+    LatencyHistogram objective_gradient;  // objective and gradient in one call
+};
+
+// Creates empty histograms.
+//
+// @returns The histograms, to be released with latency_destroy.
+Latency *latency_create();
+
+// Records a call that started at start.
+//
+// @param histogram The histogram of the callback.
+// @param start The time at which the call started, from PetscTime.
+// @param bytes The number of bytes copied between PETSc and R.
+// @returns Error code.
+PetscErrorCode latency_record(LatencyHistogram *histogram, PetscLogDouble start, double bytes);
+
+// Returns the calls of each callback as a data frame with the columns
+// callback, calls, total, p50, p99, max, all in seconds, and bytes.
+// Percentiles are the upper edges of their buckets.
+//
+// @param latency The histograms.
+// @returns The data frame.
+DataFrame latency_read(Latency *latency);
+
+// Frees the histograms.
+void latency_destroy(Latency *latency);
+
+#endif
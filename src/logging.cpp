@@ -0,0 +1,106 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include "logging.h"
+
+PetscLogEvent TAOR_Objective, TAOR_Separable, TAOR_Gradient, TAOR_Hessian;
+PetscLogEvent TAOR_Replay, TAOR_Record, TAOR_Monitor;
+PetscLogEvent TAOR_CallR, TAOR_CallNative, TAOR_GetVec, TAOR_Assembly;
+PetscLogStage TAOR_Setup = -1, TAOR_Solve = -1, TAOR_Teardown = -1;
+
+PetscErrorCode logging_register() {
+
+    PetscClassId classid;
+
+    PetscFunctionBegin;
+    catch_error(PetscLogDefaultBegin());
+    catch_error(PetscClassIdRegister("taoR", &classid));
+
+    catch_error(PetscLogEventRegister("taoRObjective", classid, &TAOR_Objective));
+    catch_error(PetscLogEventRegister("taoRSeparable", classid, &TAOR_Separable));
+    catch_error(PetscLogEventRegister("taoRGradient", classid, &TAOR_Gradient));
+    catch_error(PetscLogEventRegister("taoRHessian", classid, &TAOR_Hessian));
+    catch_error(PetscLogEventRegister("taoRReplay", classid, &TAOR_Replay));
+    catch_error(PetscLogEventRegister("taoRRecord", classid, &TAOR_Record));
+    catch_error(PetscLogEventRegister("taoRMonitor", classid, &TAOR_Monitor));
+    catch_error(PetscLogEventRegister("taoRCallR", classid, &TAOR_CallR));
+    catch_error(PetscLogEventRegister("taoRCallNative", classid, &TAOR_CallNative));
+    catch_error(PetscLogEventRegister("taoRGetVec", classid, &TAOR_GetVec));
+    catch_error(PetscLogEventRegister("taoRAssembly", classid, &TAOR_Assembly));
+
+    catch_error(PetscLogStageRegister("taoR Setup", &TAOR_Setup));
+    catch_error(PetscLogStageRegister("taoR Solve", &TAOR_Solve));
+    catch_error(PetscLogStageRegister("taoR Teardown", &TAOR_Teardown));
+    PetscFunctionReturn(0);
+}
+
+LogSnapshot logging_snapshot() {
+
+    PetscStageLog stage_log;
+    PetscLogStage stages[] = {TAOR_Setup, TAOR_Solve, TAOR_Teardown};
+    LogSnapshot snapshot(3);
+
+    if (TAOR_Setup < 0 || PetscLogGetStageLog(&stage_log) != 0) {
+        return snapshot;
+    }
+    for (int i = 0; i < 3; ++i) {
+        PetscEventPerfLog event_log = stage_log->stageInfo[stages[i]].eventLog;
+        snapshot[i].assign(event_log->eventInfo, event_log->eventInfo + event_log->numEvents);
+    }
+    return snapshot;
+}
+
+DataFrame logging_profile(const LogSnapshot &before) {
+
+    PetscStageLog stage_log;
+    const char *stage_names[] = {"setup", "solve", "teardown"};
+    LogSnapshot after = logging_snapshot();
+
+    CharacterVector stage, event;
+    NumericVector count, time, flops;
+    if (TAOR_Setup >= 0 && PetscLogGetStageLog(&stage_log) == 0) {
+        for (int i = 0; i < 3; ++i) {
+            for (size_t e = 0; e < after[i].size(); ++e) {
+
+                // Events registered during the solve have no earlier counters
+                PetscEventPerfInfo start = {};
+                if (e < before[i].size()) {
+                    start = before[i][e];
+                }
+                if (after[i][e].count == start.count) {
+                    continue;
+                }
+                stage.push_back(stage_names[i]);
+                event.push_back(stage_log->eventLog->eventInfo[e].name);
+                count.push_back(after[i][e].count - start.count);
+                time.push_back(after[i][e].time - start.time);
+                flops.push_back(after[i][e].flops - start.flops);
+            }
+        }
+    }
+
+    return DataFrame::create(
+        Named("stage") = stage,
+        Named("event") = event,
+        Named("count") = count,
+        Named("time") = time,
+        Named("flops") = flops,
+        Named("stringsAsFactors") = false
+    );
+}
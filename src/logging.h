@@ -0,0 +1,69 @@
+#ifndef logging_h
+#define logging_h
+
+#include "taoR.h"
+
+// Events that time the bridge between TAO and the objective function. The
+// callbacks registered with TAO log the evaluation as a whole, the functions
+// in utils.cpp log the calls into R, into native code, the copies between
+// PETSc and R vectors, and the assembly of Hessians.
+extern PetscLogEvent TAOR_Objective, TAOR_Separable, TAOR_Gradient, TAOR_Hessian;
+extern PetscLogEvent TAOR_Replay, TAOR_Record, TAOR_Monitor;
+extern PetscLogEvent TAOR_CallR, TAOR_CallNative, TAOR_GetVec, TAOR_Assembly;
+
+// Stages of tao_cpp.
+extern PetscLogStage TAOR_Setup, TAOR_Solve, TAOR_Teardown;
+
+// Registers the events and stages and turns on logging. Call me once after
+// PetscInitialize.
+//
+// @returns Error code.
+PetscErrorCode logging_register();
+
+// Logs an event for the lifetime of the scope, such that the event is also
+// ended if a function returns early on an error or R throws an exception.
+class LogEventScope {
+public:
+    explicit LogEventScope(PetscLogEvent event) : event(event) {
+        PetscLogEventBegin(event, 0, 0, 0, 0);
+    }
+    ~LogEventScope() {
+        PetscLogEventEnd(event, 0, 0, 0, 0);
+    }
+private:
+    PetscLogEvent event;
+};
+
+// Pushes a stage for the lifetime of the scope.
+class LogStageScope {
+public:
+    explicit LogStageScope(PetscLogStage stage) : stage(stage) {
+        if (stage >= 0) {
+            PetscLogStagePush(stage);
+        }
+    }
+    ~LogStageScope() {
+        if (stage >= 0) {
+            PetscLogStagePop();
+        }
+    }
+private:
+    PetscLogStage stage;
+};
+
+// The performance counters of all events in the stages of tao_cpp. The
+// counters accumulate over all solves, a profile of one solve is the
+// difference of two snapshots.
+typedef vector< vector<PetscEventPerfInfo> > LogSnapshot;
+
+// Takes a snapshot of the counters.
+LogSnapshot logging_snapshot();
+
+// Returns the events that occurred since a snapshot was taken as a data frame
+// with the columns stage, event, count, time in seconds and flops.
+//
+// @param before The snapshot taken before the solve.
+// @returns The data frame.
+DataFrame logging_profile(const LogSnapshot &before);
+
+#endif
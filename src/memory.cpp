@@ -0,0 +1,124 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include "logging.h"
+#include "memory.h"
+
+PetscErrorCode memory_register() {
+
+    PetscViewer viewer;
+
+    PetscFunctionBegin;
+    catch_error(PetscMemorySetGetMaximumUsage());
+
+    // The viewer of stdout lives as long as PETSc, create it before any solve
+    // so it does not count as an object of a solve
+    catch_error(PetscViewerASCIIGetStdout(PETSC_COMM_SELF, &viewer));
+    PetscFunctionReturn(0);
+}
+
+MemoryUsage memory_snapshot() {
+
+    PetscStageLog stage_log;
+    PetscLogStage stages[] = {TAOR_Setup, TAOR_Solve, TAOR_Teardown};
+    MemoryUsage usage = MemoryUsage();
+
+    PetscMemoryGetCurrentUsage(&usage.resident);
+    PetscMallocGetCurrentUsage(&usage.allocated);
+    if (TAOR_Setup < 0 || PetscLogGetStageLog(&stage_log) != 0) {
+        return usage;
+    }
+
+    // Objects are counted per stage, they may be created in one stage and
+    // destroyed in another
+    int classes = stage_log->classLog->numClasses;
+    usage.created.assign(classes, 0);
+    usage.destroyed.assign(classes, 0);
+    for (int i = 0; i < 3; ++i) {
+        PetscClassPerfLog class_log = stage_log->stageInfo[stages[i]].classLog;
+        for (int c = 0; c < classes && c < class_log->numClasses; ++c) {
+            usage.created[c] += class_log->classInfo[c].creations;
+            usage.destroyed[c] += class_log->classInfo[c].destructions;
+        }
+    }
+    return usage;
+}
+
+// the name of a class of PETSc objects
+static const char *class_name(int c) {
+    PetscStageLog stage_log;
+    PetscLogGetStageLog(&stage_log);
+    return stage_log->classLog->classInfo[c].name;
+}
+
+List memory_report(const MemoryUsage &before) {
+
+    MemoryUsage after = memory_snapshot();
+    PetscLogDouble resident_peak, allocated_peak;
+    PetscMemoryGetMaximumUsage(&resident_peak);
+    PetscMallocGetMaximumUsage(&allocated_peak);
+
+    CharacterVector name;
+    IntegerVector created, destroyed, alive;
+    for (size_t c = 0; c < after.created.size(); ++c) {
+        int created_before = c < before.created.size() ? before.created[c] : 0;
+        int destroyed_before = c < before.destroyed.size() ? before.destroyed[c] : 0;
+        int n_created = after.created[c] - created_before;
+        int n_destroyed = after.destroyed[c] - destroyed_before;
+        if (n_created == 0 && n_destroyed == 0) {
+            continue;
+        }
+        name.push_back(class_name(c));
+        created.push_back(n_created);
+        destroyed.push_back(n_destroyed);
+        alive.push_back(n_created - n_destroyed);
+    }
+
+    return List::create(
+        Named("resident_before") = before.resident,
+        Named("resident_after") = after.resident,
+        Named("resident_peak") = resident_peak,
+        Named("petsc_allocated") = after.allocated,
+        Named("petsc_peak") = allocated_peak,
+        Named("objects") = DataFrame::create(
+            Named("class") = name,
+            Named("created") = created,
+            Named("destroyed") = destroyed,
+            Named("alive") = alive,
+            Named("stringsAsFactors") = false
+        )
+    );
+}
+
+void memory_check_leaks(const MemoryUsage &before) {
+
+    MemoryUsage after = memory_snapshot();
+    string leaks;
+    for (size_t c = 0; c < after.created.size(); ++c) {
+        int created_before = c < before.created.size() ? before.created[c] : 0;
+        int destroyed_before = c < before.destroyed.size() ? before.destroyed[c] : 0;
+        int alive = (after.created[c] - created_before) - (after.destroyed[c] - destroyed_before);
+        if (alive > 0) {
+            leaks += (leaks.empty() ? "" : ", ") + string(class_name(c)) + " (" + std::to_string(alive) + ")";
+        }
+    }
+    if (!leaks.empty()) {
+        stop("PETSc objects outlived the solve: " + leaks + ".");
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef memory_h
+#define memory_h
+
+#include "taoR.h"
+
+// The memory of the process and the number of PETSc objects of each class
+// that were created and destroyed in the stages of tao_cpp.
+struct MemoryUsage {
+    PetscLogDouble resident;
+    PetscLogDouble allocated;
+    vector<int> created;
+    vector<int> destroyed;
+};
+
+// Starts to track the peak memory usage. Call me once after PetscInitialize.
+//
+// @returns Error code.
+PetscErrorCode memory_register();
+
+// Takes a snapshot of the memory usage and the object counts.
+MemoryUsage memory_snapshot();
+
+// Returns the memory usage of a solve as a list with the resident memory of
+// the process before and after the solve and at its peak, the memory
+// allocated by PETSc now and at its peak, and a data frame with the number of
+// PETSc objects of each class that were created, destroyed and are still
+// alive.
+//
+// @param before The snapshot taken before the solve.
+// @returns The list.
+List memory_report(const MemoryUsage &before);
+
+// Checks that all PETSc objects created since a snapshot have been destroyed,
+// stops with the classes of the remaining objects otherwise.
+//
+// @param before The snapshot taken before the solve.
+void memory_check_leaks(const MemoryUsage &before);
+
+#endif
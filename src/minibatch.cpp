@@ -0,0 +1,200 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include "budget.h"
+#include "progress.h"
+#include "sum.h"
+#include "utils.h"
+#include "minibatch.h"
+
+// the parameters of Adam
+static const double ADAM_BETA1 = 0.9;
+static const double ADAM_BETA2 = 0.999;
+static const double ADAM_EPSILON = 1e-8;
+
+// small sums are sampled in smaller blocks, such that there are at least this
+// many blocks to choose from
+static const long MIN_BLOCKS = 64;
+
+static double setting(List settings, const char *name, double fallback) {
+    return settings.containsElementNamed(name) ? as<double>(settings[name]) : fallback;
+}
+
+Minibatch *minibatch_create(List settings) {
+    Minibatch *minibatch = new Minibatch();
+    minibatch->batch = setting(settings, "batch", 0.01);
+    minibatch->growth = setting(settings, "growth", 1.5);
+    minibatch->theta = setting(settings, "theta", 0.9);
+    minibatch->step = setting(settings, "step", 0.01);
+    minibatch->max_iterations = (long) setting(settings, "iterations", 1000);
+    minibatch->max_epochs = setting(settings, "epochs", 10);
+    minibatch->seed = (unsigned long) setting(settings, "seed", 1);
+    return minibatch;
+}
+
+// the norm test: the number of blocks for which the variance of the mean of
+// the per-row gradients of the blocks is at most theta^2 times its squared norm
+static long norm_test(Minibatch *minibatch, int k, const vector<PetscReal> &g, const vector<PetscReal> &block_rows,
+                      const PetscReal *mean, long batch) {
+    if (batch < 2) {
+        return 2;
+    }
+    double variance = 0.0, norm = 0.0;
+    for (long b = 0; b < batch; ++b) {
+        for (int i = 0; i < k; ++i) {
+            double d = g[b * k + i] / block_rows[b] - mean[i];
+            variance += d * d;
+        }
+    }
+    variance /= batch - 1;
+    for (int i = 0; i < k; ++i) {
+        norm += mean[i] * mean[i];
+    }
+    if (variance / batch <= minibatch->theta * minibatch->theta * norm) {
+        return batch;
+    }
+    double wanted = norm > 0 ? variance / (minibatch->theta * minibatch->theta * norm) : HUGE_VAL;
+    return (long) std::min(wanted, 1e15);
+}
+
+PetscErrorCode minibatch_run(Minibatch *minibatch, Problem *problem, Tao tao_context, Vec X, Vec lower, Vec upper) {
+
+    PetscReal *x;
+    const PetscReal *lb, *ub;
+
+    PetscFunctionBegin;
+    if (minibatch == NULL) {
+        PetscFunctionReturn(0);
+    }
+
+    int k = problem->k;
+    long rows = sum_rows(problem->native);
+    long block = std::max(std::min(SUM_BLOCK, rows / MIN_BLOCKS), 1L);
+    long blocks = (rows + block - 1) / block;
+    long batch = minibatch->batch <= 1 ? (long) ceil(minibatch->batch * rows / block)
+                                       : (long) ceil(minibatch->batch / block);
+    batch = std::max(std::min(batch, blocks), std::min(blocks, 2L));
+
+    std::mt19937_64 random(minibatch->seed);
+    vector<long> order(blocks);
+    for (long b = 0; b < blocks; ++b) {
+        order[b] = b;
+    }
+    vector<PetscReal> m(k, 0.0), v(k, 0.0), mean(k), f, g, block_rows;
+    double epochs = 0.0;
+
+    catch_error(VecGetArray(X, &x));
+    catch_error(VecGetArrayRead(lower, &lb));
+    catch_error(VecGetArrayRead(upper, &ub));
+    for (long t = 1; batch < blocks && t <= minibatch->max_iterations && epochs < minibatch->max_epochs; ++t) {
+
+        // Stop on the time limit, an interrupt or cancellation, as the monitor does
+        catch_error(budget_check(problem->budget, tao_context));
+        if (problem->budget->exhausted != BUDGET_AVAILABLE || progress_cancelled(problem->progress)) {
+            break;
+        }
+
+        // Sample blocks without replacement
+        for (long b = 0; b < batch; ++b) {
+            std::swap(order[b], order[b + random() % (blocks - b)]);
+        }
+        vector<long> sample(order.begin(), order.begin() + batch);
+        std::sort(sample.begin(), sample.end());
+        f.resize(batch);
+        g.resize(batch * k);
+        block_rows.resize(batch);
+        catch_error(sum_evaluate_blocks(problem->native, k, x, block, sample, &f[0], &g[0]));
+
+        // The mean over the rows of the batch, summed in the order of the blocks
+        double sampled = 0.0, fsum = 0.0;
+        std::fill(mean.begin(), mean.end(), 0.0);
+        for (long b = 0; b < batch; ++b) {
+            block_rows[b] = std::min(block, rows - sample[b] * block);
+            sampled += block_rows[b];
+            fsum += f[b];
+            for (int i = 0; i < k; ++i) {
+                mean[i] += g[b * k + i];
+            }
+        }
+        double gnorm = 0.0;
+        for (int i = 0; i < k; ++i) {
+            mean[i] /= sampled;
+            gnorm += mean[i] * mean[i];
+        }
+        epochs += sampled / rows;
+
+        minibatch->iteration.push_back(t);
+        minibatch->rows.push_back(sampled);
+        minibatch->f.push_back(fsum / sampled * rows);
+        minibatch->gnorm.push_back(sqrt(gnorm) * rows);
+        minibatch->elapsed.push_back(budget_elapsed(problem->budget));
+        if (!problem->quiet) {
+            catch_error(PetscViewerASCIIPrintf(PETSC_VIEWER_STDOUT_SELF,
+                                               "minibatch iter = %3D, rows %D, Function value %g, Residual: %g \n",
+                                               (PetscInt) t, (PetscInt) sampled, minibatch->f.back(),
+                                               minibatch->gnorm.back()));
+        }
+
+        progress_publish(problem->progress, (int) t, minibatch->f.back(), minibatch->gnorm.back(), problem->budget, x);
+
+        // Take an Adam step and stay within the bounds
+        for (int i = 0; i < k; ++i) {
+            m[i] = ADAM_BETA1 * m[i] + (1 - ADAM_BETA1) * mean[i];
+            v[i] = ADAM_BETA2 * v[i] + (1 - ADAM_BETA2) * mean[i] * mean[i];
+            double m_hat = m[i] / (1 - pow(ADAM_BETA1, t));
+            double v_hat = v[i] / (1 - pow(ADAM_BETA2, t));
+            x[i] = std::min(std::max(x[i] - minibatch->step * m_hat / (sqrt(v_hat) + ADAM_EPSILON), lb[i]), ub[i]);
+        }
+
+        // Grow the batch once the gradient estimate is too noisy
+        long wanted = norm_test(minibatch, k, g, block_rows, &mean[0], batch);
+        if (wanted > batch) {
+            batch = std::min(blocks, std::max(wanted, (long) ceil(batch * minibatch->growth)));
+        }
+    }
+    catch_error(VecRestoreArrayRead(upper, &ub));
+    catch_error(VecRestoreArrayRead(lower, &lb));
+    catch_error(VecRestoreArray(X, &x));
+
+    // A stopped phase is the result of the solve. The estimates of f were
+    // taken before the last step, so f is evaluated on all rows at X.
+    if (problem->budget->exhausted != BUDGET_AVAILABLE && !minibatch->f.empty()) {
+        PetscReal fx;
+        catch_error(evaluate_native(X, &fx, problem->native->objfun, problem->native->data, k));
+        catch_error(budget_record(problem->budget, X, fx));
+    }
+    PetscFunctionReturn(0);
+}
+
+DataFrame minibatch_read(Minibatch *minibatch) {
+    return DataFrame::create(
+        Named("iteration") = IntegerVector(minibatch->iteration.begin(), minibatch->iteration.end()),
+        Named("rows") = NumericVector(minibatch->rows.begin(), minibatch->rows.end()),
+        Named("f") = NumericVector(minibatch->f.begin(), minibatch->f.end()),
+        Named("gnorm") = NumericVector(minibatch->gnorm.begin(), minibatch->gnorm.end()),
+        Named("elapsed") = NumericVector(minibatch->elapsed.begin(), minibatch->elapsed.end())
+    );
+}
+
+void minibatch_destroy(Minibatch *minibatch) {
+    delete minibatch;
+}
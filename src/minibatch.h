@@ -0,0 +1,57 @@
+#ifndef minibatch_h
+#define minibatch_h
+
+#include "taoR.h"
+
+// A stochastic phase that precedes the solve of a sum of terms. Every
+// iteration samples blocks of rows without replacement, estimates the
+// gradient per row from them, and takes an Adam step, projected onto the
+// bounds. Sums of fewer than 64 * SUM_BLOCK rows are split into 64 blocks. The number of blocks grows when the variance of the gradient
+// estimate is large compared to its norm (the norm test), which happens as
+// the iterates approach the minimum. The phase ends when the batch covers all
+// rows, after a number of iterations or passes over the data, or when the time
+// budget is spent; the solver then polishes the result on all rows.
+struct Minibatch {
+    double batch;
+    double growth;
+    double theta;
+    double step;
+    long max_iterations;
+    double max_epochs;
+    unsigned long seed;
+    vector<int> iteration;
+    vector<double> rows, f, gnorm, elapsed;
+};
+
+// Creates a stochastic phase.
+//
+// @param settings is a list with the initial batch (a fraction of the rows
+//        if at most 1, a number of rows otherwise), the smallest growth
+//        factor of the batch, the norm test parameter theta, the Adam step,
+//        the maximum number of iterations and epochs, and the seed.
+// @returns The phase, to be released with minibatch_destroy.
+Minibatch *minibatch_create(List settings);
+
+// Runs the stochastic phase and writes its result into X. Like the monitor
+// of the solver, every iteration publishes the progress and stops the phase
+// on the time limit, an interrupt or cancellation. A stopped phase records X
+// with its objective on all rows as the best point of the solve.
+//
+// @param minibatch The phase, may be NULL.
+// @param problem The problem, whose native objective is a sum of terms.
+// @param tao_context The TAO context.
+// @param X The starting values, overwritten.
+// @param lower The lower bounds.
+// @param upper The upper bounds.
+// @returns Error code.
+PetscErrorCode minibatch_run(Minibatch *minibatch, Problem *problem, Tao tao_context, Vec X, Vec lower, Vec upper);
+
+// Returns the iterations of the phase as a data frame with the columns
+// iteration, rows, f, gnorm and elapsed. f and gnorm are estimated from the
+// batch and scaled to all rows.
+DataFrame minibatch_read(Minibatch *minibatch);
+
+// Frees the phase.
+void minibatch_destroy(Minibatch *minibatch);
+
+#endif
@@ -0,0 +1,220 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include "native.h"
+#include "sum.h"
+
+// The draws of the Halton sequences skip their first elements, which are
+// strongly correlated across dimensions
+static const long HALTON_SKIP = 10;
+
+// The negative simulated log-likelihood of a mixed logit model. Individual n
+// chooses one of J alternatives with attributes x_nj, and the coefficients are
+// b + s * eta_nd for R draws eta_nd per individual, where only the columns in
+// random have a standard deviation s. The probability of the choice c is the
+// mean over the draws of exp(x_nc'b_d) / sum_j exp(x_nj'b_d). The attributes
+// are stored row by row, with the alternatives of an individual next to each
+// other, and the draws of an individual are next to each other, so that each
+// individual reads one contiguous block of both.
+struct MixedLogit {
+    long individuals;
+    int alternatives;
+    int columns;
+    int draws;
+    vector<int> random;
+    vector<PetscReal> x;
+    vector<int> choice;
+    vector<PetscReal> eta;
+};
+
+static int mixed_logit_terms(int k, const PetscReal *par, long begin, long end, PetscReal *f, PetscReal *g,
+                             void *data) {
+
+    MixedLogit *model = (MixedLogit *) data;
+    int J = model->alternatives, p = model->columns, R = model->draws, r = model->random.size();
+    const PetscReal *sigma = par + p;
+    vector<PetscReal> b(p), v(J), a(p), numerator(k);
+
+    for (long n = begin; n < end; ++n) {
+        const PetscReal *x = &model->x[(size_t) n * J * p];
+        const PetscReal *chosen = x + (size_t) model->choice[n] * p;
+        PetscReal likelihood = 0.0;
+        std::fill(numerator.begin(), numerator.end(), 0.0);
+
+        for (int d = 0; d < R; ++d) {
+            const PetscReal *eta = &model->eta[((size_t) n * R + d) * r];
+            std::copy(par, par + p, b.begin());
+            for (int l = 0; l < r; ++l) {
+                b[model->random[l]] += sigma[l] * eta[l];
+            }
+
+            // The logit probabilities, shifted by the largest utility
+            PetscReal largest = -HUGE_VAL;
+            for (int j = 0; j < J; ++j) {
+                PetscReal u = 0.0;
+                for (int m = 0; m < p; ++m) {
+                    u += x[j * p + m] * b[m];
+                }
+                v[j] = u;
+                largest = std::max(largest, u);
+            }
+            PetscReal total = 0.0;
+            for (int j = 0; j < J; ++j) {
+                v[j] = exp(v[j] - largest);
+                total += v[j];
+            }
+            PetscReal L = v[model->choice[n]] / total;
+            likelihood += L;
+            if (g == NULL) {
+                continue;
+            }
+
+            // d log L / d b = x_nc - sum_j p_j x_nj
+            std::copy(chosen, chosen + p, a.begin());
+            for (int j = 0; j < J; ++j) {
+                PetscReal probability = v[j] / total;
+                for (int m = 0; m < p; ++m) {
+                    a[m] -= probability * x[j * p + m];
+                }
+            }
+            for (int m = 0; m < p; ++m) {
+                numerator[m] += L * a[m];
+            }
+            for (int l = 0; l < r; ++l) {
+                numerator[p + l] += L * eta[l] * a[model->random[l]];
+            }
+        }
+
+        *f -= log(std::max(likelihood / R, DBL_MIN));
+        if (g != NULL && likelihood > 0) {
+            for (int i = 0; i < k; ++i) {
+                g[i] -= numerator[i] / likelihood;
+            }
+        }
+    }
+    return 0;
+}
+
+static void mixed_logit_destroy(void *data) {
+    delete (MixedLogit *) data;
+}
+
+// the first count primes
+static vector<int> primes(int count) {
+    vector<int> found;
+    for (int candidate = 2; (int) found.size() < count; ++candidate) {
+        bool prime = true;
+        for (size_t i = 0; i < found.size() && found[i] * found[i] <= candidate; ++i) {
+            prime = prime && candidate % found[i] != 0;
+        }
+        if (prime) {
+            found.push_back(candidate);
+        }
+    }
+    return found;
+}
+
+// Scrambled Halton draws: dimension l is the radical inverse in the l-th prime
+// base with the digits permuted at random, keeping zero in place, and
+// transformed to the standard normal distribution. The draws of individual n
+// are the elements n * R + 1, ..., n * R + R of the sequences.
+static void halton_draws(MixedLogit *model, unsigned long seed) {
+    int r = model->random.size();
+    vector<int> bases = primes(r);
+    vector< vector<int> > permutations(r);
+    std::mt19937_64 random(seed);
+    for (int l = 0; l < r; ++l) {
+        permutations[l].resize(bases[l]);
+        for (int digit = 0; digit < bases[l]; ++digit) {
+            permutations[l][digit] = digit;
+        }
+        std::shuffle(permutations[l].begin() + 1, permutations[l].end(), random);
+    }
+    long count = model->individuals * model->draws;
+    model->eta.resize((size_t) count * r);
+    for (long i = 0; i < count; ++i) {
+        for (int l = 0; l < r; ++l) {
+            PetscReal u = 0.0, scale = 1.0 / bases[l];
+            for (long index = i + 1 + HALTON_SKIP; index > 0; index /= bases[l]) {
+                u += permutations[l][index % bases[l]] * scale;
+                scale /= bases[l];
+            }
+            model->eta[(size_t) i * r + l] = R::qnorm(u, 0.0, 1.0, 1, 0);
+        }
+    }
+}
+
+Native *create_mixed_logit(List data) {
+
+    if (!data.containsElementNamed("X") || !data.containsElementNamed("choice")) {
+        stop("model data must contain X and choice.");
+    }
+    NumericMatrix X = data["X"];
+    IntegerVector choice = data["choice"];
+    std::unique_ptr<MixedLogit> model(new MixedLogit());
+    model->individuals = choice.size();
+    model->columns = X.ncol();
+    if (model->individuals == 0 || X.nrow() % model->individuals != 0) {
+        stop("X must have the same number of rows for every individual in choice.");
+    }
+    model->alternatives = X.nrow() / model->individuals;
+    model->draws = data.containsElementNamed("draws") ? model_size(data, "draws") : 100;
+    if (model->draws < 1) {
+        stop("draws must be positive.");
+    }
+
+    // The coefficients of these columns are random, 1-based in R
+    if (data.containsElementNamed("random")) {
+        IntegerVector random = data["random"];
+        for (int l = 0; l < random.size(); ++l) {
+            if (random[l] < 1 || random[l] > model->columns) {
+                stop("random must hold columns of X.");
+            }
+            model->random.push_back(random[l] - 1);
+        }
+    }
+    for (int n = 0; n < choice.size(); ++n) {
+        if (choice[n] < 1 || choice[n] > model->alternatives) {
+            stop("choice must be between 1 and the number of alternatives.");
+        }
+        model->choice.push_back(choice[n] - 1);
+    }
+    model->x.resize((size_t) X.nrow() * model->columns);
+    for (int row = 0; row < X.nrow(); ++row) {
+        for (int m = 0; m < model->columns; ++m) {
+            model->x[(size_t) row * model->columns + m] = X(row, m);
+        }
+    }
+    halton_draws(model.get(), data.containsElementNamed("seed") ? model_size(data, "seed") : 1);
+
+    NativeSum sum = NativeSum();
+    sum.terms = mixed_logit_terms;
+    sum.rows = model->individuals;
+    sum.k = model->columns + model->random.size();
+    sum.data = model.get();
+    sum.destroy = mixed_logit_destroy;
+    int threads = data.containsElementNamed("threads") ? as<int>(data["threads"]) : 1;
+    model.release();
+    return sum_create(sum, R_NilValue, threads);
+}
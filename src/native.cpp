@@ -0,0 +1,211 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include "native.h"
+
+static void native_finalizer(Native *native) {
+    if (native->destroy != NULL) {
+        native->destroy(native->data);
+    }
+    delete native;
+}
+
+SEXP wrap_native(Native *native) {
+    XPtr<Native, PreserveStorage, native_finalizer> ptr(native, true);
+    ptr.attr("class") = "tao_native";
+    return ptr;
+}
+
+vector<PetscReal> model_vector(List data, const char *name) {
+    if (!data.containsElementNamed(name)) {
+        stop(string("model data must contain ") + name + ".");
+    }
+    NumericVector values = data[name];
+    return vector<PetscReal>(values.begin(), values.end());
+}
+
+int model_size(List data, const char *name) {
+    if (!data.containsElementNamed(name)) {
+        stop(string("model data must contain ") + name + ".");
+    }
+    return as<int>(data[name]);
+}
+
+// The quadratic model sum((x - center)^2), mostly useful for testing
+struct Quadratic {
+    vector<PetscReal> center;
+    int residuals;
+};
+
+static PetscErrorCode quadratic_check(int k, Quadratic *model) {
+    PetscFunctionBegin;
+    if (k != (int) model->center.size()) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", (int) model->center.size(), k);
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode quadratic_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    Quadratic *model = (Quadratic *) data;
+    PetscFunctionBegin;
+    catch_error(quadratic_check(k, model));
+    *f = 0.0;
+    for (int i = 0; i < k; ++i) {
+        *f += (x[i] - model->center[i]) * (x[i] - model->center[i]);
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode quadratic_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    Quadratic *model = (Quadratic *) data;
+    PetscFunctionBegin;
+    catch_error(quadratic_check(k, model));
+    for (int i = 0; i < k; ++i) {
+        g[i] = 2.0 * (x[i] - model->center[i]);
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode quadratic_hessian(int k, const PetscReal *x, int n, PetscReal *h, void *data) {
+    Quadratic *model = (Quadratic *) data;
+    PetscFunctionBegin;
+    catch_error(quadratic_check(k, model));
+    for (int i = 0; i < k * k; ++i) {
+        h[i] = 0.0;
+    }
+    for (int i = 0; i < k; ++i) {
+        h[i * k + i] = 2.0;
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode quadratic_separable(int k, const PetscReal *x, int n, PetscReal *y, void *data) {
+    Quadratic *model = (Quadratic *) data;
+    PetscFunctionBegin;
+    catch_error(quadratic_check(k, model));
+    // the residuals repeat x - center as often as needed
+    for (int i = 0; i < n; ++i) {
+        y[i] = x[i % k] - model->center[i % k];
+    }
+    PetscFunctionReturn(0);
+}
+
+static void quadratic_destroy(void *data) {
+    delete (Quadratic *) data;
+}
+
+static Native *create_quadratic(List data) {
+    Quadratic *model = new Quadratic();
+    model->center = model_vector(data, "center");
+    model->residuals = data.containsElementNamed("residuals") ? model_size(data, "residuals") : model->center.size();
+    if (model->center.empty() || model->residuals < 1) {
+        delete model;
+        stop("center and residuals must not be empty.");
+    }
+
+    Native *native = new Native();
+    native->objfun = quadratic_objective;
+    native->grafun = quadratic_gradient;
+    native->hesfun = quadratic_hessian;
+    native->sepfun = quadratic_separable;
+    native->n = model->residuals;
+    native->data = model;
+    native->destroy = quadratic_destroy;
+    return native;
+}
+
+// built-in models by name
+static const struct {
+    const char *name;
+    NativeFactory create;
+} MODELS[] = {
+    {"quadratic", create_quadratic},
+    {"rosenbrock", create_rosenbrock},
+    {"powell", create_powell},
+    {"broyden", create_broyden},
+    {"boundquad", create_bound_quadratic},
+    {"glm", create_glm},
+    {"mixlogit", create_mixed_logit},
+    {"nfxp", create_nfxp},
+    {"blp", create_blp},
+    {"exponential", create_exponential},
+    {"logistic", create_logistic},
+    {"michaelis_menten", create_michaelis_menten},
+    {"exponentials", create_exponentials}
+};
+
+//' Create a built-in native objective function
+//'
+//' \code{tao_model_cpp} is an internal function of this package. It is recommended
+//' that users call \code{\link{tao_model}} instead.
+//'
+//' @param name is the name of the model.
+//' @param data is a list with the data of the model.
+//' @return an external pointer of class \code{tao_native}
+// [[Rcpp::export]]
+SEXP tao_model_cpp(String name, List data) {
+    string model = name.get_cstring();
+    for (size_t i = 0; i < sizeof(MODELS) / sizeof(MODELS[0]); ++i) {
+        if (model == MODELS[i].name) {
+            return wrap_native(MODELS[i].create(data));
+        }
+    }
+    stop("unknown model " + model + ".");
+}
+
+//' Describe a native objective function
+//'
+//' @param native is an external pointer of class \code{tao_native}.
+//' @return a list that indicates which functions the native objective provides
+//'         and the number of elements of its separable objective
+// [[Rcpp::export]]
+List tao_native_info_cpp(SEXP native) {
+    XPtr<Native> ptr(native);
+    return List::create(
+        Named("objective") = ptr->objfun != NULL,
+        Named("gradient") = ptr->grafun != NULL,
+        Named("hessian") = ptr->hesfun != NULL,
+        Named("separable") = ptr->sepfun != NULL,
+        Named("n") = ptr->n
+    );
+}
+
+//' Evaluate the gradient of a native objective function
+//'
+//' @param native is an external pointer of class \code{tao_native}.
+//' @param x is the point at which the gradient is evaluated.
+//' @return the gradient at \code{x}
+// [[Rcpp::export]]
+NumericVector tao_native_gradient_cpp(SEXP native, NumericVector x) {
+    XPtr<Native> ptr(native);
+    int k = x.size();
+    NumericVector g(k);
+    PetscReal f;
+    PetscErrorCode error_code;
+    if (ptr->grafun != NULL) {
+        error_code = ptr->grafun(k, x.begin(), k, g.begin(), ptr->data);
+    } else if (ptr->objgrad != NULL) {
+        error_code = ptr->objgrad(k, x.begin(), &f, g.begin(), ptr->data);
+    } else {
+        stop("the native objective has no gradient.");
+    }
+    if (error_code != 0) {
+        stop("the gradient of the native objective failed.");
+    }
+    return g;
+}
@@ -0,0 +1,55 @@
+#ifndef native_h
+#define native_h
+
+#include "taoR.h"
+
+// Creates a native objective from the data passed in from R.
+typedef Native *(*NativeFactory)(List data);
+
+// Wraps a native objective in an external pointer of class "tao_native" that
+// frees it when it is garbage collected.
+//
+// @param native The native objective, owned by the external pointer.
+// @returns The external pointer.
+SEXP wrap_native(Native *native);
+
+// Reads a numeric vector from a list of model data, stops if it is missing.
+//
+// @param data The model data.
+// @param name The name of the element.
+// @returns The values.
+vector<PetscReal> model_vector(List data, const char *name);
+
+// Reads a size from a list of model data, stops if it is missing.
+//
+// @param data The model data.
+// @param name The name of the element.
+// @returns The size.
+int model_size(List data, const char *name);
+
+// The classic test problems of unconstrained and bound-constrained
+// minimization, see problems.cpp.
+Native *create_rosenbrock(List data);
+Native *create_powell(List data);
+Native *create_broyden(List data);
+Native *create_bound_quadratic(List data);
+
+// Generalized linear models, see glm.cpp.
+Native *create_glm(List data);
+
+// Mixed logit models, see mixlogit.cpp.
+Native *create_mixed_logit(List data);
+
+// Dynamic discrete choice by the nested fixed point algorithm, see nfxp.cpp.
+Native *create_nfxp(List data);
+
+// Random coefficients logit demand by GMM, see blp.cpp.
+Native *create_blp(List data);
+
+// Curves fitted by nonlinear least squares, see curves.cpp.
+Native *create_exponential(List data);
+Native *create_logistic(List data);
+Native *create_michaelis_menten(List data);
+Native *create_exponentials(List data);
+
+#endif
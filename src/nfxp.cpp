@@ -0,0 +1,315 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include "native.h"
+
+// The negative log-likelihood of the bus engine replacement model of Rust
+// (1987), estimated by the nested fixed point algorithm. Each period, the
+// mileage state x in 0, ..., S - 1 either stays (keep, flow utility
+// -theta * scale * x) or is reset to zero (replace, flow utility -RC), and
+// then moves up by j states with probability p_j, stopping at S - 1. The
+// parameters are RC and theta. The expected value function EV solves
+// EV = T(EV) with
+//
+//   T(EV)(x) = sum_j p_j log(exp(v_keep(x')) + exp(v_replace(x'))),
+//   v_keep(x) = -theta * scale * x + beta EV(x),
+//   v_replace(x) = -RC + beta EV(0), where x' = min(x + j, S - 1).
+//
+// The fixed point is found by contraction steps followed by Newton steps on
+// EV - T(EV) = 0, starting from the fixed point of the previous evaluation.
+// The gradient follows from the implicit function theorem, dEV/dpar =
+// (I - T_EV)^-1 T_par, with the matrix of the last Newton step.
+struct Nfxp {
+    int states;
+    vector<PetscReal> transition;
+    PetscReal beta, scale, tolerance;
+    int contractions, newton_steps;
+    vector<PetscReal> keep, replace;  // the number of decisions by state
+    vector<PetscReal> ev;             // the last fixed point
+    vector<PetscReal> last_x;
+    PetscReal last_f;
+    vector<PetscReal> last_g;
+    bool has_f, has_g;
+};
+
+// One application of T, which also returns the probabilities to keep
+static void nfxp_bellman(Nfxp *model, const PetscReal *x, const PetscReal *ev, PetscReal *tev, PetscReal *pkeep,
+                         PetscReal *lse) {
+    int S = model->states;
+    PetscReal replace = -x[0] + model->beta * ev[0];
+    for (int s = 0; s < S; ++s) {
+        PetscReal keep = -x[1] * model->scale * s + model->beta * ev[s];
+        PetscReal largest = std::max(keep, replace);
+        PetscReal a = exp(keep - largest), b = exp(replace - largest);
+        lse[s] = largest + log(a + b);
+        pkeep[s] = a / (a + b);
+    }
+    int J = model->transition.size();
+    for (int s = 0; s < S; ++s) {
+        PetscReal sum = 0.0;
+        for (int j = 0; j < J; ++j) {
+            sum += model->transition[j] * lse[std::min(s + j, S - 1)];
+        }
+        tev[s] = sum;
+    }
+}
+
+// Writes I - T_EV into a dense matrix in column-major order
+static void nfxp_jacobian(Nfxp *model, const PetscReal *pkeep, PetscReal *A) {
+    int S = model->states, J = model->transition.size();
+    std::fill(A, A + (size_t) S * S, 0.0);
+    for (int s = 0; s < S; ++s) {
+        A[(size_t) s * S + s] = 1.0;
+        for (int j = 0; j < J; ++j) {
+            int next = std::min(s + j, S - 1);
+            PetscReal weight = model->beta * model->transition[j];
+            A[(size_t) next * S + s] -= weight * pkeep[next];
+            A[s] -= weight * (1.0 - pkeep[next]);
+        }
+    }
+}
+
+// Solves A y = b for a vector b of length S, in place
+static PetscErrorCode nfxp_solve(KSP ksp, Vec b, Vec y, PetscReal *values, int S) {
+    PetscReal *array;
+    PetscFunctionBegin;
+    catch_error(VecGetArray(b, &array));
+    std::copy(values, values + S, array);
+    catch_error(VecRestoreArray(b, &array));
+    catch_error(KSPSolve(ksp, b, y));
+    catch_error(VecGetArray(y, &array));
+    std::copy(array, array + S, values);
+    catch_error(VecRestoreArray(y, &array));
+    PetscFunctionReturn(0);
+}
+
+// Creates the matrix of the Newton steps on the storage A and its LU solver
+static PetscErrorCode nfxp_workspace(int S, PetscReal *A, Mat *matrix, KSP *ksp, Vec *b, Vec *y) {
+    PC pc;
+    PetscFunctionBegin;
+    catch_error(MatCreateSeqDense(PETSC_COMM_SELF, S, S, A, matrix));
+    catch_error(KSPCreate(PETSC_COMM_SELF, ksp));
+    catch_error(KSPSetType(*ksp, KSPPREONLY));
+    catch_error(KSPGetPC(*ksp, &pc));
+    catch_error(PCSetType(pc, PCLU));
+    catch_error(VecCreateSeq(PETSC_COMM_SELF, S, b));
+    catch_error(VecCreateSeq(PETSC_COMM_SELF, S, y));
+    PetscFunctionReturn(0);
+}
+
+// Newton steps EV -= (I - T_EV)^-1 (EV - T(EV)) from ev, then the likelihood
+// and, with the last matrix, its gradient by the implicit function theorem
+static PetscErrorCode nfxp_newton(int k, const PetscReal *x, bool gradient, Nfxp *model, vector<PetscReal> &ev,
+                                  Mat matrix, KSP ksp, Vec b, Vec y) {
+
+    int S = model->states, J = model->transition.size();
+    vector<PetscReal> tev(S), pkeep(S), lse(S);
+
+    PetscFunctionBegin;
+    bool converged = false;
+    for (int it = 0; it <= model->newton_steps && !converged; ++it) {
+        nfxp_bellman(model, x, &ev[0], &tev[0], &pkeep[0], &lse[0]);
+        PetscReal residual = 0.0;
+        for (int s = 0; s < S; ++s) {
+            tev[s] = ev[s] - tev[s];
+            residual = std::max(residual, fabs(tev[s]));
+        }
+        converged = residual < model->tolerance;
+        PetscReal *array;
+        catch_error(MatDenseGetArray(matrix, &array));
+        nfxp_jacobian(model, &pkeep[0], array);
+        catch_error(MatDenseRestoreArray(matrix, &array));
+        catch_error(MatAssemblyBegin(matrix, MAT_FINAL_ASSEMBLY));
+        catch_error(MatAssemblyEnd(matrix, MAT_FINAL_ASSEMBLY));
+        catch_error(KSPSetOperators(ksp, matrix, matrix));
+        if (!converged) {
+            catch_error(nfxp_solve(ksp, b, y, &tev[0], S));
+            for (int s = 0; s < S; ++s) {
+                ev[s] -= tev[s];
+            }
+        }
+    }
+    if (!converged) {
+        model->ev.assign(S, 0.0);
+        SETERRQ1(PETSC_COMM_SELF, PETSC_ERR_NOT_CONVERGED,
+                 "The value function did not converge in %d Newton steps", model->newton_steps);
+    }
+
+    // The likelihood of the decisions, see nfxp_bellman for the choice values
+    PetscReal f = 0.0;
+    for (int s = 0; s < S; ++s) {
+        if (model->keep[s] > 0) {
+            f -= model->keep[s] * log(pkeep[s]);
+        }
+        if (model->replace[s] > 0) {
+            f -= model->replace[s] * log(1.0 - pkeep[s]);
+        }
+    }
+
+    // dEV/dpar = (I - T_EV)^-1 T_par, and the derivatives of the log
+    // probabilities are the differences of the derivatives of the values
+    vector<PetscReal> dev_rc(S), dev_theta(S);
+    if (gradient) {
+        for (int s = 0; s < S; ++s) {
+            PetscReal rc = 0.0, theta = 0.0;
+            for (int j = 0; j < J; ++j) {
+                int next = std::min(s + j, S - 1);
+                rc -= model->transition[j] * (1.0 - pkeep[next]);
+                theta -= model->transition[j] * pkeep[next] * model->scale * next;
+            }
+            dev_rc[s] = rc;
+            dev_theta[s] = theta;
+        }
+        catch_error(nfxp_solve(ksp, b, y, &dev_rc[0], S));
+        catch_error(nfxp_solve(ksp, b, y, &dev_theta[0], S));
+        model->last_g.assign(2, 0.0);
+        for (int s = 0; s < S; ++s) {
+            PetscReal weight = model->keep[s] * (1.0 - pkeep[s]) - model->replace[s] * pkeep[s];
+            PetscReal rc = model->beta * (dev_rc[s] - dev_rc[0]) + 1.0;
+            PetscReal theta = -model->scale * s + model->beta * (dev_theta[s] - dev_theta[0]);
+            model->last_g[0] -= weight * rc;
+            model->last_g[1] -= weight * theta;
+        }
+    }
+
+    // The next evaluation starts from this fixed point
+    model->ev = ev;
+    model->last_x.assign(x, x + k);
+    model->last_f = f;
+    model->has_f = true;
+    model->has_g = gradient;
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode nfxp_evaluate(int k, const PetscReal *x, bool gradient, Nfxp *model) {
+
+    int S = model->states;
+    vector<PetscReal> ev(model->ev), tev(S), pkeep(S), lse(S), A((size_t) S * S);
+    Mat matrix = NULL;
+    KSP ksp = NULL;
+    Vec b = NULL, y = NULL;
+
+    PetscFunctionBegin;
+    if (k != 2) {
+        SETERRQ1(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected 2 parameters, got %d", k);
+    }
+    if (model->has_f && (model->has_g || !gradient) && std::equal(x, x + k, model->last_x.begin())) {
+        PetscFunctionReturn(0);
+    }
+
+    // Contraction steps while far from the fixed point
+    for (int it = 0; it < model->contractions; ++it) {
+        nfxp_bellman(model, x, &ev[0], &tev[0], &pkeep[0], &lse[0]);
+        PetscReal change = 0.0;
+        for (int s = 0; s < S; ++s) {
+            change = std::max(change, fabs(tev[s] - ev[s]));
+        }
+        ev.swap(tev);
+        if (change < 1e-2) {
+            break;
+        }
+    }
+
+    // The PETSc objects of the Newton steps are freed on every path
+    PetscErrorCode error_code = nfxp_workspace(S, &A[0], &matrix, &ksp, &b, &y);
+    if (error_code == 0) {
+        error_code = nfxp_newton(k, x, gradient, model, ev, matrix, ksp, b, y);
+    }
+    VecDestroy(&y);
+    VecDestroy(&b);
+    KSPDestroy(&ksp);
+    MatDestroy(&matrix);
+    CHKERRQ(error_code);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode nfxp_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    Nfxp *model = (Nfxp *) data;
+    PetscFunctionBegin;
+    catch_error(nfxp_evaluate(k, x, false, model));
+    *f = model->last_f;
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode nfxp_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    Nfxp *model = (Nfxp *) data;
+    PetscFunctionBegin;
+    catch_error(nfxp_evaluate(k, x, true, model));
+    std::copy(model->last_g.begin(), model->last_g.end(), g);
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode nfxp_objective_gradient(int k, const PetscReal *x, PetscReal *f, PetscReal *g, void *data) {
+    Nfxp *model = (Nfxp *) data;
+    PetscFunctionBegin;
+    catch_error(nfxp_evaluate(k, x, true, model));
+    *f = model->last_f;
+    std::copy(model->last_g.begin(), model->last_g.end(), g);
+    PetscFunctionReturn(0);
+}
+
+static void nfxp_destroy(void *data) {
+    delete (Nfxp *) data;
+}
+
+static PetscReal nfxp_setting(List data, const char *name, PetscReal fallback) {
+    return data.containsElementNamed(name) ? as<PetscReal>(data[name]) : fallback;
+}
+
+Native *create_nfxp(List data) {
+
+    std::unique_ptr<Nfxp> model(new Nfxp());
+    vector<PetscReal> state = model_vector(data, "state");
+    vector<PetscReal> decision = model_vector(data, "decision");
+    model->transition = model_vector(data, "transition");
+    model->states = (int) nfxp_setting(data, "states", 90);
+    model->beta = nfxp_setting(data, "beta", 0.9999);
+    model->scale = nfxp_setting(data, "scale", 0.001);
+    model->tolerance = nfxp_setting(data, "tolerance", 1e-10);
+    model->contractions = (int) nfxp_setting(data, "contractions", 20);
+    model->newton_steps = (int) nfxp_setting(data, "newton_steps", 20);
+    if (state.size() != decision.size() || model->states < 2 || model->transition.empty() ||
+        !(model->beta >= 0 && model->beta < 1)) {
+        stop("state and decision must have the same length, with at least two states and 0 <= beta < 1.");
+    }
+
+    // The likelihood only depends on the number of decisions by state
+    model->keep.assign(model->states, 0.0);
+    model->replace.assign(model->states, 0.0);
+    for (size_t i = 0; i < state.size(); ++i) {
+        int s = (int) state[i] - 1;
+        if (s < 0 || s >= model->states || (decision[i] != 0 && decision[i] != 1)) {
+            stop("state must be between 1 and states and decision 0 (keep) or 1 (replace).");
+        }
+        (decision[i] == 1 ? model->replace : model->keep)[s] += 1.0;
+    }
+    model->ev.assign(model->states, 0.0);
+
+    Native *native = new Native();
+    native->objfun = nfxp_objective;
+    native->grafun = nfxp_gradient;
+    native->objgrad = nfxp_objective_gradient;
+    native->n = 1;
+    native->data = model.release();
+    native->destroy = nfxp_destroy;
+    return native;
+}
@@ -0,0 +1,172 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <strings.h>
+#include <unordered_map>
+#include "options.h"
+
+// parsed option sets by content, cleared when it grows too large
+static std::unordered_map< string, std::shared_ptr<const OptionSet> > option_cache;
+static const size_t OPTION_CACHE_SIZE = 64;
+
+// solves are numbered to give each its own options prefix
+static long solve_count = 0;
+
+static PetscReal parse_real(const string &name, const string &value) {
+    char *end;
+    PetscReal parsed = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0') {
+        stop("option " + name + " must be a number, got " + value + ".");
+    }
+    return parsed;
+}
+
+static bool parse_bool(const string &name, const string &value) {
+    const char *v = value.c_str();
+    if (value.empty() || !strcasecmp(v, "true") || !strcasecmp(v, "yes") || !strcasecmp(v, "on") || !strcmp(v, "1")) {
+        return true;
+    }
+    if (!strcasecmp(v, "false") || !strcasecmp(v, "no") || !strcasecmp(v, "off") || !strcmp(v, "0")) {
+        return false;
+    }
+    stop("option " + name + " must be true or false, got " + value + ".");
+}
+
+static OptionSet *parse(List options) {
+
+    OptionSet *set = new OptionSet();
+    set->max_it = PETSC_DEFAULT;
+    set->max_funcs = PETSC_DEFAULT;
+    set->gatol = set->grtol = set->gttol = PETSC_DEFAULT;
+    set->catol = set->crtol = PETSC_DEFAULT;
+    set->fmin = 0;
+    set->has_fmin = false;
+    set->fd_gradient = false;
+
+    if (options.size() == 0) {
+        return set;
+    }
+
+    CharacterVector names = options.names();
+    for (int i = 0; i < options.size(); ++i) {
+        string name = names[i];
+        string value = options[i];
+        if (!name.empty() && name[0] == '-') {
+            name = name.substr(1);
+        }
+
+        if (name == "tao_max_it") {
+            set->max_it = (PetscInt) parse_real(name, value);
+        } else if (name == "tao_max_funcs") {
+            set->max_funcs = (PetscInt) parse_real(name, value);
+        } else if (name == "tao_gatol") {
+            set->gatol = parse_real(name, value);
+        } else if (name == "tao_grtol") {
+            set->grtol = parse_real(name, value);
+        } else if (name == "tao_gttol") {
+            set->gttol = parse_real(name, value);
+        } else if (name == "tao_catol") {
+            set->catol = parse_real(name, value);
+        } else if (name == "tao_crtol") {
+            set->crtol = parse_real(name, value);
+        } else if (name == "tao_fmin") {
+            set->fmin = parse_real(name, value);
+            set->has_fmin = true;
+        } else if (name == "tao_fd_gradient") {
+            set->fd_gradient = parse_bool(name, value);
+        } else {
+            set->other.push_back(std::make_pair(name, value));
+        }
+    }
+    return set;
+}
+
+std::shared_ptr<const OptionSet> options_parse(List options) {
+
+    // The content of the control list is the key
+    string key;
+    if (options.size() > 0) {
+        CharacterVector names = options.names();
+        for (int i = 0; i < options.size(); ++i) {
+            string value = options[i];
+            key += names[i];
+            key += '\0';
+            key += value;
+            key += '\0';
+        }
+    }
+
+    auto cached = option_cache.find(key);
+    if (cached != option_cache.end()) {
+        return cached->second;
+    }
+    if (option_cache.size() >= OPTION_CACHE_SIZE) {
+        option_cache.clear();
+    }
+    std::shared_ptr<const OptionSet> set(parse(options));
+    option_cache[key] = set;
+    return set;
+}
+
+string options_prefix() {
+    return "taoR" + std::to_string(++solve_count) + "_";
+}
+
+PetscErrorCode options_apply(const OptionSet *options, Tao tao_context, const string &prefix) {
+
+    PetscFunctionBegin;
+    catch_error(TaoSetOptionsPrefix(tao_context, prefix.c_str()));
+
+    // Typed values are set directly
+    catch_error(TaoSetTolerances(tao_context, options->gatol, options->grtol, options->gttol));
+    catch_error(TaoSetConstraintTolerances(tao_context, options->catol, options->crtol));
+    if (options->max_it != PETSC_DEFAULT) {
+        catch_error(TaoSetMaximumIterations(tao_context, options->max_it));
+    }
+    if (options->max_funcs != PETSC_DEFAULT) {
+        catch_error(TaoSetMaximumFunctionEvaluations(tao_context, options->max_funcs));
+    }
+    if (options->has_fmin) {
+        catch_error(TaoSetFunctionLowerBound(tao_context, options->fmin));
+    }
+    if (options->fd_gradient) {
+        catch_error(TaoSetGradientRoutine(tao_context, TaoDefaultComputeGradient, NULL));
+    }
+
+    // All other options are only visible to this solve
+    for (size_t i = 0; i < options->other.size(); ++i) {
+        string flag = "-" + prefix + options->other[i].first;
+        const string &value = options->other[i].second;
+        catch_error(PetscOptionsSetValue(NULL, flag.c_str(), value.empty() ? NULL : value.c_str()));
+    }
+    catch_error(TaoSetFromOptions(tao_context));
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode options_clear(const OptionSet *options, const string &prefix) {
+
+    PetscFunctionBegin;
+    if (options == NULL) {
+        PetscFunctionReturn(0);
+    }
+    for (size_t i = 0; i < options->other.size(); ++i) {
+        string flag = "-" + prefix + options->other[i].first;
+        catch_error(PetscOptionsClearValue(NULL, flag.c_str()));
+    }
+    PetscFunctionReturn(0);
+}
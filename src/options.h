@@ -0,0 +1,49 @@
+#ifndef options_h
+#define options_h
+
+#include "taoR.h"
+#include <memory>
+#include <utility>
+
+// The control list of a solve, parsed once. Options that TAO exposes through
+// its API are kept as typed values and applied directly; all other options
+// are inserted into the options database under the prefix of the solve.
+struct OptionSet {
+    PetscInt max_it;
+    PetscInt max_funcs;
+    PetscReal gatol, grtol, gttol;
+    PetscReal catol, crtol;
+    PetscReal fmin;
+    bool has_fmin;
+    bool fd_gradient;
+    vector< std::pair<string, string> > other;
+};
+
+// Parses a control list. Option sets are cached by content, so repeated
+// solves with the same control list are not parsed again.
+//
+// @param options is the list to read. The names are the flags, the values
+//        are passed in as strings.
+// @returns The parsed option set.
+std::shared_ptr<const OptionSet> options_parse(List options);
+
+// Creates an options prefix that is unique to a solve.
+string options_prefix();
+
+// Applies an option set to a solver whose type and callbacks are set, then
+// reads the remaining options from the database.
+//
+// @param options The option set.
+// @param tao_context The TAO context.
+// @param prefix The options prefix of the solve.
+// @returns Error code.
+PetscErrorCode options_apply(const OptionSet *options, Tao tao_context, const string &prefix);
+
+// Removes the options of a solve from the options database.
+//
+// @param options The option set, may be NULL.
+// @param prefix The options prefix of the solve.
+// @returns Error code.
+PetscErrorCode options_clear(const OptionSet *options, const string &prefix);
+
+#endif
@@ -0,0 +1,96 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include "pool.h"
+
+static void pool_work(ThreadPool *pool, int thread) {
+
+    long seen = 0;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    for (;;) {
+        pool->start.wait(guard, [&] { return pool->stopping || pool->generation != seen; });
+        if (pool->stopping) {
+            return;
+        }
+        seen = pool->generation;
+        guard.unlock();
+        pool->task(thread);
+        guard.lock();
+        if (--pool->running == 0) {
+            pool->done.notify_one();
+        }
+    }
+}
+
+ThreadPool *pool_create(int threads) {
+
+    ThreadPool *pool = new ThreadPool();
+    pool->generation = 0;
+    pool->running = 0;
+    pool->stopping = false;
+    for (int t = 1; t < threads; ++t) {
+        pool->workers.push_back(std::thread(pool_work, pool, t));
+    }
+    return pool;
+}
+
+int pool_threads(ThreadPool *pool) {
+    return pool == NULL ? 1 : pool->workers.size() + 1;
+}
+
+void pool_run(ThreadPool *pool, const std::function<void(int)> &task) {
+
+    if (pool == NULL || pool->workers.empty()) {
+        task(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->task = task;
+        pool->running = pool->workers.size();
+        pool->generation++;
+    }
+    pool->start.notify_all();
+    task(0);
+
+    std::unique_lock<std::mutex> guard(pool->lock);
+    pool->done.wait(guard, [&] { return pool->running == 0; });
+}
+
+void pool_share(long count, int threads, int thread, long *begin, long *end) {
+    *begin = count * thread / threads;
+    *end = count * (thread + 1) / threads;
+}
+
+void pool_destroy(ThreadPool *pool) {
+
+    if (pool == NULL) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->stopping = true;
+    }
+    pool->start.notify_all();
+    for (size_t t = 0; t < pool->workers.size(); ++t) {
+        pool->workers[t].join();
+    }
+    delete pool;
+}
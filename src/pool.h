@@ -0,0 +1,52 @@
+#ifndef pool_h
+#define pool_h
+
+#include "taoR.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A fixed set of worker threads that run one task at a time. Each task is
+// called once per thread with the index of the thread; the calling thread
+// runs index 0. Tasks must not call R or PETSc.
+struct ThreadPool {
+    vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    std::function<void(int)> task;
+    long generation;
+    int running;
+    bool stopping;
+};
+
+// Creates a pool.
+//
+// @param threads The number of threads, including the calling thread.
+// @returns The pool, to be released with pool_destroy.
+ThreadPool *pool_create(int threads);
+
+// Returns the number of threads of a pool, 1 if it is NULL.
+int pool_threads(ThreadPool *pool);
+
+// Runs a task on all threads and waits until it has finished everywhere.
+//
+// @param pool The pool, may be NULL to run the task on the calling thread.
+// @param task The task.
+void pool_run(ThreadPool *pool, const std::function<void(int)> &task);
+
+// Returns the first and one past the last element of the share of a thread
+// when count elements are split evenly into contiguous ranges.
+//
+// @param count The number of elements.
+// @param threads The number of threads.
+// @param thread The index of the thread.
+// @param begin Receives the first element.
+// @param end Receives one past the last element.
+void pool_share(long count, int threads, int thread, long *begin, long *end);
+
+// Stops and joins the threads and frees the pool.
+void pool_destroy(ThreadPool *pool);
+
+#endif
@@ -0,0 +1,344 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include "native.h"
+
+// An entry of a sparse Jacobian
+struct Entry {
+    int row;
+    int col;
+    PetscReal value;
+};
+
+// A nonlinear least-squares problem sum(r(x)^2) with as many residuals as
+// parameters. The Jacobian is sparse with its entries in row order, the
+// curvature adds sum(r_i * hessian(r_i)) to a dense matrix.
+struct LeastSquares {
+    int k;
+    void (*residuals)(int k, const PetscReal *x, PetscReal *r);
+    void (*jacobian)(int k, const PetscReal *x, vector<Entry> &J);
+    void (*curvature)(int k, const PetscReal *x, const PetscReal *r, PetscReal *H);
+    vector<PetscReal> r;
+    vector<Entry> J;
+};
+
+static PetscErrorCode least_squares_check(int k, LeastSquares *model) {
+    PetscFunctionBegin;
+    if (k != model->k) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", model->k, k);
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode least_squares_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    LeastSquares *model = (LeastSquares *) data;
+    PetscFunctionBegin;
+    catch_error(least_squares_check(k, model));
+    model->residuals(k, x, &model->r[0]);
+    *f = 0.0;
+    for (int i = 0; i < k; ++i) {
+        *f += model->r[i] * model->r[i];
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode least_squares_separable(int k, const PetscReal *x, int n, PetscReal *y, void *data) {
+    LeastSquares *model = (LeastSquares *) data;
+    PetscFunctionBegin;
+    catch_error(least_squares_check(k, model));
+    model->residuals(k, x, y);
+    PetscFunctionReturn(0);
+}
+
+// the gradient is 2 * J'r
+static PetscErrorCode least_squares_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    LeastSquares *model = (LeastSquares *) data;
+    PetscFunctionBegin;
+    catch_error(least_squares_check(k, model));
+    model->residuals(k, x, &model->r[0]);
+    model->J.clear();
+    model->jacobian(k, x, model->J);
+    for (int i = 0; i < k; ++i) {
+        g[i] = 0.0;
+    }
+    for (size_t e = 0; e < model->J.size(); ++e) {
+        const Entry &entry = model->J[e];
+        g[entry.col] += 2.0 * entry.value * model->r[entry.row];
+    }
+    PetscFunctionReturn(0);
+}
+
+// the hessian is 2 * (J'J + sum(r_i * hessian(r_i)))
+static PetscErrorCode least_squares_hessian(int k, const PetscReal *x, int n, PetscReal *h, void *data) {
+    LeastSquares *model = (LeastSquares *) data;
+    PetscFunctionBegin;
+    catch_error(least_squares_check(k, model));
+    model->residuals(k, x, &model->r[0]);
+    model->J.clear();
+    model->jacobian(k, x, model->J);
+    for (int i = 0; i < k * k; ++i) {
+        h[i] = 0.0;
+    }
+    model->curvature(k, x, &model->r[0], h);
+
+    // J'J, row by row of J
+    size_t start = 0;
+    while (start < model->J.size()) {
+        size_t end = start;
+        while (end < model->J.size() && model->J[end].row == model->J[start].row) {
+            ++end;
+        }
+        for (size_t a = start; a < end; ++a) {
+            for (size_t b = start; b < end; ++b) {
+                h[model->J[a].col * k + model->J[b].col] += model->J[a].value * model->J[b].value;
+            }
+        }
+        start = end;
+    }
+    for (int i = 0; i < k * k; ++i) {
+        h[i] *= 2.0;
+    }
+    PetscFunctionReturn(0);
+}
+
+static void least_squares_destroy(void *data) {
+    delete (LeastSquares *) data;
+}
+
+static Native *wrap_least_squares(LeastSquares *model) {
+    model->r.resize(model->k);
+
+    Native *native = new Native();
+    native->objfun = least_squares_objective;
+    native->grafun = least_squares_gradient;
+    native->hesfun = least_squares_hessian;
+    native->sepfun = least_squares_separable;
+    native->n = model->k;
+    native->data = model;
+    native->destroy = least_squares_destroy;
+    return native;
+}
+
+// The extended Rosenbrock function, with residuals 10 * (x[2i] - x[2i-1]^2)
+// and 1 - x[2i-1] for each pair of parameters
+static void rosenbrock_residuals(int k, const PetscReal *x, PetscReal *r) {
+    for (int i = 0; i < k; i += 2) {
+        r[i] = 10.0 * (x[i + 1] - x[i] * x[i]);
+        r[i + 1] = 1.0 - x[i];
+    }
+}
+
+static void rosenbrock_jacobian(int k, const PetscReal *x, vector<Entry> &J) {
+    for (int i = 0; i < k; i += 2) {
+        J.push_back({i, i, -20.0 * x[i]});
+        J.push_back({i, i + 1, 10.0});
+        J.push_back({i + 1, i, -1.0});
+    }
+}
+
+static void rosenbrock_curvature(int k, const PetscReal *x, const PetscReal *r, PetscReal *H) {
+    for (int i = 0; i < k; i += 2) {
+        H[i * k + i] += -20.0 * r[i];
+    }
+}
+
+Native *create_rosenbrock(List data) {
+    int k = model_size(data, "k");
+    if (k < 2 || k % 2 != 0) {
+        stop("the Rosenbrock function requires an even number of parameters.");
+    }
+    LeastSquares *model = new LeastSquares();
+    model->k = k;
+    model->residuals = rosenbrock_residuals;
+    model->jacobian = rosenbrock_jacobian;
+    model->curvature = rosenbrock_curvature;
+    return wrap_least_squares(model);
+}
+
+// The extended Powell singular function, in blocks of four parameters
+static void powell_residuals(int k, const PetscReal *x, PetscReal *r) {
+    for (int i = 0; i < k; i += 4) {
+        r[i] = x[i] + 10.0 * x[i + 1];
+        r[i + 1] = sqrt(5.0) * (x[i + 2] - x[i + 3]);
+        r[i + 2] = (x[i + 1] - 2.0 * x[i + 2]) * (x[i + 1] - 2.0 * x[i + 2]);
+        r[i + 3] = sqrt(10.0) * (x[i] - x[i + 3]) * (x[i] - x[i + 3]);
+    }
+}
+
+static void powell_jacobian(int k, const PetscReal *x, vector<Entry> &J) {
+    for (int i = 0; i < k; i += 4) {
+        PetscReal a = x[i + 1] - 2.0 * x[i + 2];
+        PetscReal b = x[i] - x[i + 3];
+        J.push_back({i, i, 1.0});
+        J.push_back({i, i + 1, 10.0});
+        J.push_back({i + 1, i + 2, sqrt(5.0)});
+        J.push_back({i + 1, i + 3, -sqrt(5.0)});
+        J.push_back({i + 2, i + 1, 2.0 * a});
+        J.push_back({i + 2, i + 2, -4.0 * a});
+        J.push_back({i + 3, i, 2.0 * sqrt(10.0) * b});
+        J.push_back({i + 3, i + 3, -2.0 * sqrt(10.0) * b});
+    }
+}
+
+static void powell_curvature(int k, const PetscReal *x, const PetscReal *r, PetscReal *H) {
+    for (int i = 0; i < k; i += 4) {
+        PetscReal c = r[i + 2];
+        PetscReal d = sqrt(10.0) * r[i + 3];
+        H[(i + 1) * k + i + 1] += 2.0 * c;
+        H[(i + 1) * k + i + 2] += -4.0 * c;
+        H[(i + 2) * k + i + 1] += -4.0 * c;
+        H[(i + 2) * k + i + 2] += 8.0 * c;
+        H[i * k + i] += 2.0 * d;
+        H[i * k + i + 3] += -2.0 * d;
+        H[(i + 3) * k + i] += -2.0 * d;
+        H[(i + 3) * k + i + 3] += 2.0 * d;
+    }
+}
+
+Native *create_powell(List data) {
+    int k = model_size(data, "k");
+    if (k < 4 || k % 4 != 0) {
+        stop("the extended Powell function requires a multiple of four parameters.");
+    }
+    LeastSquares *model = new LeastSquares();
+    model->k = k;
+    model->residuals = powell_residuals;
+    model->jacobian = powell_jacobian;
+    model->curvature = powell_curvature;
+    return wrap_least_squares(model);
+}
+
+// The Broyden tridiagonal function, with residuals
+// (3 - 2 x[i]) x[i] - x[i-1] - 2 x[i+1] + 1
+static void broyden_residuals(int k, const PetscReal *x, PetscReal *r) {
+    for (int i = 0; i < k; ++i) {
+        PetscReal previous = i > 0 ? x[i - 1] : 0.0;
+        PetscReal next = i < k - 1 ? x[i + 1] : 0.0;
+        r[i] = (3.0 - 2.0 * x[i]) * x[i] - previous - 2.0 * next + 1.0;
+    }
+}
+
+static void broyden_jacobian(int k, const PetscReal *x, vector<Entry> &J) {
+    for (int i = 0; i < k; ++i) {
+        if (i > 0) {
+            J.push_back({i, i - 1, -1.0});
+        }
+        J.push_back({i, i, 3.0 - 4.0 * x[i]});
+        if (i < k - 1) {
+            J.push_back({i, i + 1, -2.0});
+        }
+    }
+}
+
+static void broyden_curvature(int k, const PetscReal *x, const PetscReal *r, PetscReal *H) {
+    for (int i = 0; i < k; ++i) {
+        H[i * k + i] += -4.0 * r[i];
+    }
+}
+
+Native *create_broyden(List data) {
+    int k = model_size(data, "k");
+    if (k < 1) {
+        stop("the Broyden tridiagonal function requires at least one parameter.");
+    }
+    LeastSquares *model = new LeastSquares();
+    model->k = k;
+    model->residuals = broyden_residuals;
+    model->jacobian = broyden_jacobian;
+    model->curvature = broyden_curvature;
+    return wrap_least_squares(model);
+}
+
+// The quadratic 0.5 x'Ax - b'x with the tridiagonal matrix A = (-1, 2, -1),
+// for bound-constrained minimization
+struct BoundQuadratic {
+    vector<PetscReal> b;
+};
+
+static PetscErrorCode bound_quadratic_check(int k, BoundQuadratic *model) {
+    PetscFunctionBegin;
+    if (k != (int) model->b.size()) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", (int) model->b.size(), k);
+    }
+    PetscFunctionReturn(0);
+}
+
+// A x, with zeros beyond the ends
+static PetscReal tridiagonal_row(int k, const PetscReal *x, int i) {
+    PetscReal previous = i > 0 ? x[i - 1] : 0.0;
+    PetscReal next = i < k - 1 ? x[i + 1] : 0.0;
+    return 2.0 * x[i] - previous - next;
+}
+
+static PetscErrorCode bound_quadratic_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    BoundQuadratic *model = (BoundQuadratic *) data;
+    PetscFunctionBegin;
+    catch_error(bound_quadratic_check(k, model));
+    *f = 0.0;
+    for (int i = 0; i < k; ++i) {
+        *f += 0.5 * x[i] * tridiagonal_row(k, x, i) - model->b[i] * x[i];
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode bound_quadratic_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    BoundQuadratic *model = (BoundQuadratic *) data;
+    PetscFunctionBegin;
+    catch_error(bound_quadratic_check(k, model));
+    for (int i = 0; i < k; ++i) {
+        g[i] = tridiagonal_row(k, x, i) - model->b[i];
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode bound_quadratic_hessian(int k, const PetscReal *x, int n, PetscReal *h, void *data) {
+    BoundQuadratic *model = (BoundQuadratic *) data;
+    PetscFunctionBegin;
+    catch_error(bound_quadratic_check(k, model));
+    for (int i = 0; i < k * k; ++i) {
+        h[i] = 0.0;
+    }
+    for (int i = 0; i < k; ++i) {
+        h[i * k + i] = 2.0;
+        if (i > 0) {
+            h[i * k + i - 1] = -1.0;
+            h[(i - 1) * k + i] = -1.0;
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+static void bound_quadratic_destroy(void *data) {
+    delete (BoundQuadratic *) data;
+}
+
+Native *create_bound_quadratic(List data) {
+    BoundQuadratic *model = new BoundQuadratic();
+    model->b = model_vector(data, "b");
+
+    Native *native = new Native();
+    native->objfun = bound_quadratic_objective;
+    native->grafun = bound_quadratic_gradient;
+    native->hesfun = bound_quadratic_hessian;
+    native->n = 1;
+    native->data = model;
+    native->destroy = bound_quadratic_destroy;
+    return native;
+}
@@ -0,0 +1,196 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <algorithm>
+#include "solver.h"
+#include "budget.h"
+
+// Orders grid points by their value so that each solve can be warm-started
+// from its neighbor.
+struct GridOrder {
+    const NumericVector *grid;
+    bool operator()(int a, int b) const { return (*grid)[a] < (*grid)[b]; }
+};
+
+// Fixes parameter j at value and solves from the starting values in warm.
+// The solution is written back into warm.
+static PetscErrorCode solve_grid_point(Tao tao_context, Vec x, Vec lb, Vec ub,
+                                       NumericVector lower_bounds, NumericVector upper_bounds,
+                                       int j, PetscReal value, vector<PetscReal> &warm) {
+
+    PetscReal *px, *pl, *pu;
+    int k = warm.size();
+
+    PetscFunctionBegin;
+    catch_error(VecGetArray(x, &px));
+    catch_error(VecGetArray(lb, &pl));
+    catch_error(VecGetArray(ub, &pu));
+    for (int i = 0; i < k; ++i) {
+        pl[i] = lower_bounds[i];
+        pu[i] = upper_bounds[i];
+        px[i] = std::min(std::max(warm[i], pl[i]), pu[i]);
+    }
+    pl[j] = pu[j] = px[j] = value;
+    catch_error(VecRestoreArray(x, &px));
+    catch_error(VecRestoreArray(lb, &pl));
+    catch_error(VecRestoreArray(ub, &pu));
+
+    catch_error(TaoSetVariableBounds(tao_context, lb, ub));
+    catch_error(TaoSetInitialVector(tao_context, x));
+    catch_error(TaoResetStatistics(tao_context));
+    catch_error(TaoSolve(tao_context));
+
+    catch_error(VecGetArray(x, &px));
+    std::copy(px, px + k, warm.begin());
+    catch_error(VecRestoreArray(x, &px));
+    PetscFunctionReturn(0);
+}
+
+//' Profile an objective function over a grid of fixed parameter values
+//'
+//' \code{tao_profile_cpp} is an internal function of this package. It is recommended
+//' that users call \code{\link{tao_profile}} instead.
+//'
+//' A single TAO solver is created and re-used for all grid points. Parameter
+//' \code{index} is fixed by setting its lower and upper bound to the grid value,
+//' and each solve is warm-started from the solution at the neighboring grid point,
+//' walking outwards from the grid point closest to the starting value.
+//'
+//' @param functions is a list of Rcpp functions. The first is always the objective
+//'        function. The second and third are optionally the Jacobian and the Hessian
+//'        functions.
+//' @param start_values is a vector containing the starting values of the parameters.
+//' @param method is a string that determines the type of optimizer to be used.
+//' @param options is a list containing option values for the optimizer
+//' @param n is the number of elements in the objective function.
+//' @param lower_bounds is a vector with lower bounds
+//' @param upper_bounds is a vector with upper bounds
+//' @param index is the (one-based) index of the parameter to profile.
+//' @param grid is a vector of values at which parameter \code{index} is fixed.
+//' @return a list with the profiled objective function values, the parameter
+//'         values, the number of iterations and the convergence reason at each
+//'         grid point, the reason is empty for points that were not solved,
+//'         and whether the profile was interrupted
+// [[Rcpp::export]]
+List tao_profile_cpp(List functions,
+                     NumericVector start_values,
+                     String method,
+                     List options,
+                     int n,
+                     NumericVector lower_bounds,
+                     NumericVector upper_bounds,
+                     int index,
+                     NumericVector grid) {
+
+    int k = start_values.size();
+    int j = index - 1;
+    int points = grid.size();
+
+    if (j < 0 || j >= k) {
+        stop("index must be between 1 and the number of parameters.");
+    }
+
+    // Set up the solver once, it is re-used for every grid point
+    Solver *solver;
+    PetscErrorCode error = solver_create(&solver, functions, start_values, method, options, n,
+                                         lower_bounds, upper_bounds, List::create(Named("quiet") = true));
+    if (error != 0) {
+        stop("the profile failed with PETSc error code %d.", error);
+    }
+    SolverScope scope(solver);
+
+    // Walk through the grid in ascending order, starting from the point
+    // closest to the starting value
+    vector<int> order(points);
+    for (int i = 0; i < points; ++i) {
+        order[i] = i;
+    }
+    GridOrder by_value = { &grid };
+    std::sort(order.begin(), order.end(), by_value);
+
+    int center = 0;
+    for (int i = 1; i < points; ++i) {
+        if (fabs(grid[order[i]] - start_values[j]) < fabs(grid[order[center]] - start_values[j])) {
+            center = i;
+        }
+    }
+
+    NumericVector value(points, NA_REAL);
+    NumericMatrix par(points, k);
+    IntegerVector iterations(points, NA_INTEGER);
+    vector<string> reason(points);
+    bool interrupted = false;
+    std::fill(par.begin(), par.end(), NA_REAL);
+
+    vector<PetscReal> start(start_values.begin(), start_values.end());
+    vector<PetscReal> warm = start;
+
+    for (int step = 0; step < points; ++step) {
+
+        // Once the upper half is done, restart the lower half from the center
+        int i = center + step;
+        if (i >= points) {
+            i = center - (i - points + 1);
+            if (i == center - 1) {
+                for (int l = 0; l < k; ++l) {
+                    warm[l] = par(order[center], l);
+                }
+            }
+        }
+
+        // An interrupt stops the profile, the remaining grid points are NA
+        int row = order[i];
+        {
+            BudgetHandlerScope handler(solver->problem.budget);
+            error = solve_grid_point(solver->tao_context, solver->x, solver->lb, solver->ub,
+                                     lower_bounds, upper_bounds, j, grid[row], warm);
+        }
+        if (error == BUDGET_EXHAUSTED && solver->problem.budget->exhausted != BUDGET_AVAILABLE) {
+            interrupted = true;
+            break;
+        }
+
+        // The solver is destroyed by its scope when the error unwinds
+        PetscReal fc;
+        PetscInt its;
+        if (error == 0) {
+            error = TaoGetSolutionStatus(solver->tao_context, &its, &fc, 0, 0, 0, 0);
+        }
+        if (error != 0) {
+            stop("the profile failed with PETSc error code %d.", error);
+        }
+        value[row] = fc;
+        iterations[row] = its;
+        reason[row] = budget_reason(solver->problem.budget, solver->tao_context);
+        for (int l = 0; l < k; ++l) {
+            par(row, l) = warm[l];
+        }
+        if (solver->problem.budget->exhausted != BUDGET_AVAILABLE) {
+            interrupted = true;
+            break;
+        }
+    }
+
+    return List::create(
+        Named("value") = value,
+        Named("x") = par,
+        Named("iterations") = iterations,
+        Named("reason") = reason,
+        Named("interrupted") = interrupted
+    );
+}
@@ -0,0 +1,268 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include "progress.h"
+#include "budget.h"
+
+static const char *STATUS_NAMES[] = {"starting", "running", "finished", "cancelled", "failed"};
+
+static size_t progress_size(int k) {
+    return sizeof(ProgressRecord) + k * sizeof(double);
+}
+
+static double *progress_x(ProgressRecord *record) {
+    return (double *) (record + 1);
+}
+
+Progress *progress_create(int k) {
+
+    Progress *progress = new Progress();
+    progress->size = progress_size(k);
+    progress->record = (ProgressRecord *) calloc(1, progress->size);
+    progress->record->k = k;
+    progress->record->pid = getpid();
+    progress->record->eta = NAN;
+    progress->mapped = false;
+    progress->last_iterations = -1;
+    return progress;
+}
+
+Progress *progress_map(string path, int k, int access) {
+
+    bool create = access == PROGRESS_CREATE;
+    int flags = create ? O_RDWR | O_CREAT | O_TRUNC : access == PROGRESS_WRITE ? O_RDWR : O_RDONLY;
+    int fd = open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // readers may take the number of parameters from the file
+    if (k < 0) {
+        ProgressRecord header;
+        if (create || pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.k < 0) {
+            close(fd);
+            return NULL;
+        }
+        k = header.k;
+    }
+
+    size_t size = progress_size(k);
+    struct stat info;
+    if ((create && ftruncate(fd, size) != 0) || fstat(fd, &info) != 0 || (size_t) info.st_size < size) {
+        close(fd);
+        return NULL;
+    }
+
+    int protection = access == PROGRESS_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *memory = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    Progress *progress = new Progress();
+    progress->record = (ProgressRecord *) memory;
+    progress->size = size;
+    progress->mapped = true;
+    progress->last_iterations = -1;
+    if (create) {
+        progress->record->k = k;
+        progress->record->pid = getpid();
+        progress->record->eta = NAN;
+    }
+    return progress;
+}
+
+// marks the beginning of an update, readers retry until it has ended
+static void begin_write(ProgressRecord *record) {
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_write(ProgressRecord *record) {
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Estimates the remaining time of a solve as the earliest of the time at which
+// it reaches its limits on iterations, evaluations and time, and the time at
+// which the gradient norm reaches the absolute tolerance at its recent rate
+// of convergence. Returns NaN if there is no estimate.
+static double estimate_remaining(Progress *progress, Tao tao_context, Budget *budget,
+                                 PetscInt its, PetscReal gnorm, double elapsed) {
+
+    PetscInt max_it;
+    PetscReal gatol, grtol, gttol;
+    double eta = INFINITY;
+
+    if (its > 0) {
+        double per_iteration = elapsed / its;
+        if (TaoGetMaximumIterations(tao_context, &max_it) == 0 && max_it > its) {
+            eta = std::min(eta, (max_it - its) * per_iteration);
+        }
+        if (TaoGetTolerances(tao_context, &gatol, &grtol, &gttol) == 0 && gatol > 0) {
+            if (gnorm <= gatol) {
+                eta = 0;
+            } else if (progress->last_iterations >= 0 && its > progress->last_iterations
+                       && gnorm < progress->last_gnorm) {
+                double rate = log(progress->last_gnorm / gnorm) / (its - progress->last_iterations);
+                eta = std::min(eta, log(gnorm / gatol) / rate * per_iteration);
+            }
+        }
+    }
+    if (budget != NULL && budget->max_evaluations > 0 && budget->evaluations > 0) {
+        double per_evaluation = elapsed / budget->evaluations;
+        eta = std::min(eta, std::max(budget->max_evaluations - budget->evaluations, 0L) * per_evaluation);
+    }
+    if (budget != NULL && budget->max_time > 0) {
+        eta = std::min(eta, std::max(budget->max_time - elapsed, 0.0));
+    }
+    return isinf(eta) ? NAN : eta;
+}
+
+// publishes the state of a running solve
+static void write_record(ProgressRecord *record, int iterations, int reason, double f, double gnorm,
+                         Budget *budget, double elapsed, double eta, const PetscReal *x) {
+    begin_write(record);
+    record->status = PROGRESS_RUNNING;
+    record->iterations = iterations;
+    record->reason = reason;
+    record->f = f;
+    record->gnorm = gnorm;
+    record->evaluations = budget != NULL ? budget->evaluations : 0;
+    record->elapsed = elapsed;
+    record->eta = eta;
+    memcpy(progress_x(record), x, record->k * sizeof(double));
+    end_write(record);
+}
+
+PetscErrorCode progress_update(Progress *progress, Tao tao_context, Budget *budget) {
+
+    PetscInt its;
+    PetscReal fc, gnorm;
+    TaoConvergedReason reason;
+    Vec X;
+    const PetscReal *x;
+
+    PetscFunctionBegin;
+    if (progress == NULL) {
+        PetscFunctionReturn(0);
+    }
+
+    catch_error(TaoGetSolutionStatus(tao_context, &its, &fc, &gnorm, 0, 0, &reason));
+    catch_error(TaoGetSolutionVector(tao_context, &X));
+    double elapsed = budget != NULL ? budget_elapsed(budget) : 0;
+    double eta = estimate_remaining(progress, tao_context, budget, its, gnorm, elapsed);
+    if (its != progress->last_iterations) {
+        progress->last_iterations = its;
+        progress->last_gnorm = gnorm;
+    }
+    catch_error(VecGetArrayRead(X, &x));
+    write_record(progress->record, its, reason, fc, gnorm, budget, elapsed, eta, x);
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+}
+
+void progress_publish(Progress *progress, int iterations, double f, double gnorm, Budget *budget,
+                      const PetscReal *x) {
+
+    if (progress == NULL) {
+        return;
+    }
+    double elapsed = budget != NULL ? budget_elapsed(budget) : 0;
+    double eta = budget != NULL && budget->max_time > 0 ? std::max(budget->max_time - elapsed, 0.0) : NAN;
+    write_record(progress->record, iterations, TAO_CONTINUE_ITERATING, f, gnorm, budget, elapsed, eta, x);
+}
+
+void progress_set_status(Progress *progress, int status) {
+
+    if (progress == NULL) {
+        return;
+    }
+
+    begin_write(progress->record);
+    progress->record->status = status;
+    end_write(progress->record);
+}
+
+void progress_cancel(Progress *progress) {
+    if (progress != NULL) {
+        __atomic_store_n(&progress->record->cancel, 1, __ATOMIC_RELEASE);
+    }
+}
+
+bool progress_cancelled(Progress *progress) {
+    return progress != NULL && __atomic_load_n(&progress->record->cancel, __ATOMIC_ACQUIRE) != 0;
+}
+
+List progress_read(Progress *progress) {
+
+    if (progress == NULL) {
+        return List::create(Named("status") = STATUS_NAMES[PROGRESS_STARTING]);
+    }
+
+    ProgressRecord *record = progress->record;
+    ProgressRecord snapshot;
+    NumericVector x(record->k);
+
+    // retry until no write happened while copying
+    uint64_t sequence;
+    do {
+        sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        memcpy(&snapshot, record, sizeof(ProgressRecord));
+        memcpy(x.begin(), progress_x(record), record->k * sizeof(double));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((sequence & 1) || sequence != __atomic_load_n(&record->sequence, __ATOMIC_RELAXED));
+
+    int status = snapshot.status;
+    if (status < PROGRESS_STARTING || status > PROGRESS_FAILED) {
+        status = PROGRESS_FAILED;
+    }
+
+    return List::create(
+        Named("status") = STATUS_NAMES[status],
+        Named("iterations") = snapshot.iterations,
+        Named("f") = snapshot.f,
+        Named("gnorm") = snapshot.gnorm,
+        Named("reason") = snapshot.reason,
+        Named("evaluations") = snapshot.evaluations,
+        Named("elapsed") = snapshot.elapsed,
+        Named("eta") = isnan(snapshot.eta) ? NA_REAL : snapshot.eta,
+        Named("pid") = snapshot.pid,
+        Named("x") = x
+    );
+}
+
+void progress_close(Progress *progress) {
+
+    if (progress == NULL) {
+        return;
+    }
+
+    if (progress->mapped) {
+        munmap(progress->record, progress->size);
+    } else {
+        free(progress->record);
+    }
+    delete progress;
+}
@@ -0,0 +1,114 @@
+#ifndef progress_h
+#define progress_h
+
+#include "taoR.h"
+#include <stdint.h>
+
+// Status of a solve as reported by its progress record.
+enum {
+    PROGRESS_STARTING = 0,
+    PROGRESS_RUNNING = 1,
+    PROGRESS_FINISHED = 2,
+    PROGRESS_CANCELLED = 3,
+    PROGRESS_FAILED = 4
+};
+
+// Access to a progress record mapped from a file.
+enum {
+    PROGRESS_READ = 0,    // polling, which only needs read permission
+    PROGRESS_WRITE = 1,   // requesting cancellation
+    PROGRESS_CREATE = 2   // the solve, which creates and initializes the file
+};
+
+// The progress record is written by the monitor and read by other threads or
+// processes. Writers bump sequence to an odd value before and to an even value
+// after each update (a seqlock), so readers never block the solver and retry
+// if they observe an odd or changed sequence. The current iterate, k values,
+// follows the record. The layout is fixed, such that monitoring tools outside
+// of R can map the file and read it, too.
+typedef struct {
+    uint64_t sequence;
+    int32_t status;
+    int32_t cancel;
+    int32_t iterations;
+    int32_t reason;
+    int32_t k;
+    int32_t pid;
+    double f;
+    double gnorm;
+    double evaluations;
+    double elapsed;
+    double eta;
+} ProgressRecord;
+
+// The progress record and the state of the writer that is needed to
+// estimate the remaining time.
+struct Progress {
+    ProgressRecord *record;
+    size_t size;
+    bool mapped;
+    int last_iterations;
+    double last_gnorm;
+};
+
+// Allocates a progress record in memory, e.g. for a solve on another thread.
+//
+// @param k The number of parameters.
+// @returns The progress, to be released with progress_close.
+Progress *progress_create(int k);
+
+// Maps a progress record from a file that can be shared between processes.
+//
+// @param path The path of the file.
+// @param k The number of parameters, or -1 to read it from an existing file.
+// @param access PROGRESS_READ, PROGRESS_WRITE or PROGRESS_CREATE. A record
+//               that is mapped for reading must not be written.
+// @returns The progress or NULL if the file does not exist, cannot be
+//          accessed or is incomplete.
+Progress *progress_map(string path, int k, int access);
+
+// Publishes the current state of the solver, the number of evaluations, the
+// elapsed time, and an estimate of the remaining time.
+//
+// @param progress The progress record, may be NULL.
+// @param tao_context The TAO context.
+// @param budget The budget of the solve.
+// @returns Error code.
+PetscErrorCode progress_update(Progress *progress, Tao tao_context, Budget *budget);
+
+// Publishes the state of a phase that runs before the solver, such as the
+// stochastic phase of a sum of terms, whose estimate of the remaining time
+// only depends on the time limit.
+//
+// @param progress The progress record, may be NULL.
+// @param iterations The number of iterations of the phase.
+// @param f The objective function value.
+// @param gnorm The gradient norm.
+// @param budget The budget of the solve.
+// @param x The current iterate.
+void progress_publish(Progress *progress, int iterations, double f, double gnorm, Budget *budget,
+                      const PetscReal *x);
+
+// Sets the status of the solve.
+//
+// @param progress The progress record, may be NULL.
+// @param status The status.
+void progress_set_status(Progress *progress, int status);
+
+// Requests that the solve is cancelled at the next iteration.
+void progress_cancel(Progress *progress);
+
+// Whether cancellation was requested.
+bool progress_cancelled(Progress *progress);
+
+// Reads a consistent snapshot of a progress record.
+//
+// @param progress The progress record, may be NULL.
+// @returns A list with status, iterations, f, gnorm, reason, evaluations,
+//          elapsed, eta and x.
+List progress_read(Progress *progress);
+
+// Unmaps or frees a progress record.
+void progress_close(Progress *progress);
+
+#endif
@@ -0,0 +1,159 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <math.h>
+#include <algorithm>
+#include "trace.h"
+#include "replay.h"
+
+// the key of an evaluation: its type and the bytes of its parameters
+static string replay_key(int type, const PetscReal *x, int k) {
+    string key(1, (char) type);
+    key.append((const char *) x, k * sizeof(PetscReal));
+    return key;
+}
+
+Replay *replay_open(string path, int k, int n, double tolerance) {
+
+    FILE *file = fopen(path.c_str(), "rb");
+    TraceHeader header;
+    if (file == NULL || fread(&header, sizeof(header), 1, file) != 1 || !trace_valid(&header)) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        stop("cannot read replay file " + path + ".");
+    }
+    if (header.k != k || header.width < std::max(k, n)) {
+        fclose(file);
+        stop("the replay file " + path + " belongs to a problem with " + std::to_string(header.k) + " parameters.");
+    }
+
+    Replay *replay = new Replay();
+    replay->k = k;
+    replay->width = header.width;
+    replay->tolerance = tolerance;
+
+    // Later evaluations of the same parameters replace earlier ones
+    vector<double> record(2 + k + header.width);
+    for (uint64_t r = 0; r < header.records; ++r) {
+        if (fread(&record[0], sizeof(double), record.size(), file) != record.size()) {
+            break;
+        }
+        int type = (int) record[1];
+        if (type == TRACE_HESSIAN || type < TRACE_OBJECTIVE || type > TRACE_SEPARABLE) {
+            continue;
+        }
+        const PetscReal *x = &record[2];
+        const PetscReal *y = &record[2 + k];
+        replay->exact[replay_key(type, x, k)] = vector<PetscReal>(y, y + header.width);
+        replay->points[type].insert(replay->points[type].end(), x, x + k);
+        replay->values[type].insert(replay->values[type].end(), y, y + header.width);
+    }
+    fclose(file);
+    return replay;
+}
+
+// the index of the recorded evaluation that is nearest to x, or -1
+static long replay_nearest(Replay *replay, int type, const PetscReal *x) {
+
+    int k = replay->k;
+    const vector<PetscReal> &points = replay->points[type];
+    long best = -1;
+    double best_distance = replay->tolerance * replay->tolerance;
+    for (size_t r = 0; r * k < points.size(); ++r) {
+        double distance = 0;
+        for (int i = 0; i < k && distance <= best_distance; ++i) {
+            double d = points[r * k + i] - x[i];
+            distance += d * d;
+        }
+        if (distance <= best_distance) {
+            best = r;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+// the kinds of lookups, in the order in which a pair of lookups reports them
+enum {
+    REPLAY_EXACT = 0,
+    REPLAY_NEAREST = 1,
+    REPLAY_MISSED = 2
+};
+
+// looks up an evaluation without counting it
+static int replay_find(Replay *replay, int type, const PetscReal *x, PetscReal *y, int count) {
+
+    unordered_map<string, vector<PetscReal> >::const_iterator it = replay->exact.find(replay_key(type, x, replay->k));
+    if (it != replay->exact.end()) {
+        std::copy(it->second.begin(), it->second.begin() + count, y);
+        return REPLAY_EXACT;
+    }
+
+    long r = replay->tolerance > 0 ? replay_nearest(replay, type, x) : -1;
+    if (r < 0) {
+        return REPLAY_MISSED;
+    }
+    const PetscReal *values = &replay->values[type][r * replay->width];
+    std::copy(values, values + count, y);
+    return REPLAY_NEAREST;
+}
+
+static bool replay_count(Replay *replay, int found) {
+    if (found == REPLAY_EXACT) {
+        replay->hits++;
+    } else if (found == REPLAY_NEAREST) {
+        replay->nearest++;
+    } else {
+        replay->misses++;
+    }
+    return found != REPLAY_MISSED;
+}
+
+bool replay_lookup(Replay *replay, int type, const PetscReal *x, PetscReal *y, int count) {
+
+    if (replay == NULL) {
+        return false;
+    }
+    return replay_count(replay, replay_find(replay, type, x, y, count));
+}
+
+bool replay_lookup(Replay *replay, const PetscReal *x, PetscReal *f, PetscReal *g) {
+
+    if (replay == NULL) {
+        return false;
+    }
+    int found = replay_find(replay, TRACE_OBJECTIVE, x, f, 1);
+    if (found != REPLAY_MISSED) {
+        found = std::max(found, replay_find(replay, TRACE_GRADIENT, x, g, replay->k));
+    }
+    return replay_count(replay, found);
+}
+
+List replay_read(Replay *replay) {
+    return List::create(
+        Named("exact") = (double) replay->hits,
+        Named("nearest") = (double) replay->nearest,
+        Named("missed") = (double) replay->misses
+    );
+}
+
+void replay_close(Replay *replay) {
+    delete replay;
+}
@@ -0,0 +1,61 @@
+#ifndef replay_h
+#define replay_h
+
+#include "taoR.h"
+#include <unordered_map>
+
+// The evaluations of a trace file, fed back to a solve that requests the same
+// parameters. Parameters match if their bytes are equal. If the tolerance is
+// positive, a request without an exact match is answered by the nearest
+// recorded evaluation of the same type, provided that it is within the
+// tolerance in Euclidean distance. Hessians are not traced and are always
+// evaluated.
+struct Replay {
+    int k;
+    int width;
+    double tolerance;
+    unordered_map<string, vector<PetscReal> > exact;
+    vector<PetscReal> points[4];
+    vector<PetscReal> values[4];
+    long hits;
+    long nearest;
+    long misses;
+};
+
+// Reads the evaluations of a trace file.
+//
+// @param path The path of the trace file.
+// @param k The number of parameters of the solve.
+// @param n The number of residuals of the solve.
+// @param tolerance The largest distance of a nearest match, 0 for exact
+//        matches only.
+// @returns A new replay, to be released with replay_close.
+Replay *replay_open(string path, int k, int n, double tolerance);
+
+// Looks up an evaluation.
+//
+// @param replay The replay, may be NULL.
+// @param type The trace type of the evaluation.
+// @param x The parameters.
+// @param y Receives the recorded values.
+// @param count The number of values.
+// @returns Whether a recorded evaluation was found.
+bool replay_lookup(Replay *replay, int type, const PetscReal *x, PetscReal *y, int count);
+
+// Looks up the objective function and the gradient of one evaluation of
+// both, which counts as a single lookup.
+//
+// @param replay The replay, may be NULL.
+// @param x The parameters.
+// @param f Receives the recorded objective function value.
+// @param g Receives the recorded gradient.
+// @returns Whether both were found.
+bool replay_lookup(Replay *replay, const PetscReal *x, PetscReal *f, PetscReal *g);
+
+// Returns the number of exact, nearest and missed lookups.
+List replay_read(Replay *replay);
+
+// Frees the replay.
+void replay_close(Replay *replay);
+
+#endif
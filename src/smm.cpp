@@ -0,0 +1,245 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include "native.h"
+#include "pool.h"
+
+// the draws are aligned for vector loads
+static const size_t ARENA_ALIGNMENT = 64;
+
+// Simulated moments against targets. The residuals are
+// sqrt(w_j) * (mean of the simulated moments j - target j), averaged over the
+// replications in their order, so they do not depend on the number of
+// threads. The draws of all replications are generated once into one arena.
+struct SmmObjective {
+    NativeSimulator simulator;
+    RObject owner;
+    ThreadPool *pool;
+    int replications;
+    PetscReal *arena;
+    vector<PetscReal> targets, scale;
+    vector<PetscReal> moments;
+    vector<int> error;
+};
+
+static PetscErrorCode smm_residuals(int k, const PetscReal *x, int n, PetscReal *y, void *data) {
+
+    SmmObjective *model = (SmmObjective *) data;
+    const NativeSimulator &simulator = model->simulator;
+    int m = simulator.moments;
+
+    PetscFunctionBegin;
+    if (simulator.k > 0 && k != simulator.k) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", simulator.k, k);
+    }
+    int threads = pool_threads(model->pool);
+    pool_run(model->pool, [&](int thread) {
+        long begin, end;
+        pool_share(model->replications, threads, thread, &begin, &end);
+        model->error[thread] = 0;
+        for (long s = begin; s < end && model->error[thread] == 0; ++s) {
+            model->error[thread] = simulator.simulate(k, x, model->arena + s * simulator.draws, m,
+                                                      &model->moments[s * m], simulator.data);
+        }
+    });
+    for (size_t t = 0; t < model->error.size(); ++t) {
+        if (model->error[t] != 0) {
+            SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_LIB, "The simulations of thread %d failed with error %d",
+                     (int) t, model->error[t]);
+        }
+    }
+
+    for (int j = 0; j < m; ++j) {
+        y[j] = 0.0;
+    }
+    for (int s = 0; s < model->replications; ++s) {
+        for (int j = 0; j < m; ++j) {
+            y[j] += model->moments[s * m + j];
+        }
+    }
+    for (int j = 0; j < m; ++j) {
+        y[j] = model->scale[j] * (y[j] / model->replications - model->targets[j]);
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode smm_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    SmmObjective *model = (SmmObjective *) data;
+    vector<PetscReal> r(model->simulator.moments);
+    PetscFunctionBegin;
+    catch_error(smm_residuals(k, x, r.size(), &r[0], data));
+    *f = 0.0;
+    for (size_t j = 0; j < r.size(); ++j) {
+        *f += r[j] * r[j];
+    }
+    PetscFunctionReturn(0);
+}
+
+static void smm_destroy(void *data) {
+    SmmObjective *model = (SmmObjective *) data;
+    pool_destroy(model->pool);
+    free(model->arena);
+    if (model->simulator.destroy != NULL) {
+        model->simulator.destroy(model->simulator.data);
+    }
+    delete model;
+}
+
+// A sample of draws normal observations mu + exp(log_sigma) * e, with the
+// sample mean and variance as moments
+static int normal_simulate(int k, const PetscReal *x, const PetscReal *draws, int m, PetscReal *moments, void *data) {
+    long n = *(long *) data;
+    PetscReal sigma = exp(x[1]), sum = 0.0, squares = 0.0;
+    for (long i = 0; i < n; ++i) {
+        PetscReal y = x[0] + sigma * draws[i];
+        sum += y;
+        squares += y * y;
+    }
+    moments[0] = sum / n;
+    moments[1] = squares / n - moments[0] * moments[0];
+    return 0;
+}
+
+// An AR(1) series y_t = rho y_(t-1) + exp(log_sigma) * e_t of draws periods,
+// started at zero, with the auxiliary least-squares estimates of rho and of
+// the variance of the innovations as moments
+static int ar1_simulate(int k, const PetscReal *x, const PetscReal *draws, int m, PetscReal *moments, void *data) {
+    long n = *(long *) data;
+    PetscReal sigma = exp(x[1]), previous = 0.0, yy = 0.0, yx = 0.0, xx = 0.0;
+    for (long t = 0; t < n; ++t) {
+        PetscReal y = x[0] * previous + sigma * draws[t];
+        yy += y * y;
+        yx += y * previous;
+        xx += previous * previous;
+        previous = y;
+    }
+    PetscReal rho = xx > 0 ? yx / xx : 0.0;
+    moments[0] = rho;
+    moments[1] = (yy - rho * yx) / n;
+    return 0;
+}
+
+static void simulator_size_destroy(void *data) {
+    delete (long *) data;
+}
+
+// built-in simulators by name
+static const struct {
+    const char *name;
+    NativeSimulate simulate;
+} SIMULATORS[] = {
+    {"normal", normal_simulate},
+    {"ar1", ar1_simulate}
+};
+
+//' Create a native objective for the simulated method of moments
+//'
+//' \code{tao_smm_cpp} is an internal function of this package. It is recommended
+//' that users call \code{\link{tao_smm}} instead.
+//'
+//' @param simulator is the name of a built-in simulator or an external
+//'        pointer of class \code{tao_simulator} to a \code{NativeSimulator}.
+//' @param settings is a list with the \code{targets}, the \code{weights}, the
+//'        number of \code{replications}, the number of \code{draws} of a
+//'        built-in simulator, the \code{distribution} of the draws, the
+//'        \code{seed}, and the number of \code{threads}.
+//' @return an external pointer of class \code{tao_native}
+// [[Rcpp::export]]
+SEXP tao_smm_cpp(SEXP simulator, List settings) {
+
+    NativeSimulator native_simulator = NativeSimulator();
+    RObject owner;
+    if (Rf_inherits(simulator, "tao_simulator")) {
+        XPtr<NativeSimulator> pointer(simulator);
+        if (pointer.get() == NULL || pointer->simulate == NULL) {
+            stop("the simulator has no function.");
+        }
+        native_simulator = *pointer;
+        native_simulator.destroy = NULL;
+        owner = simulator;
+    } else {
+        string name = as<string>(simulator);
+        for (size_t i = 0; i < sizeof(SIMULATORS) / sizeof(SIMULATORS[0]); ++i) {
+            if (name == SIMULATORS[i].name) {
+                native_simulator.simulate = SIMULATORS[i].simulate;
+            }
+        }
+        if (native_simulator.simulate == NULL) {
+            stop("unknown simulator " + name + ".");
+        }
+        native_simulator.draws = model_size(settings, "draws");
+        native_simulator.moments = 2;
+        native_simulator.k = 2;
+        native_simulator.data = new long(native_simulator.draws);
+        native_simulator.destroy = simulator_size_destroy;
+    }
+
+    SmmObjective *model = new SmmObjective();
+    model->simulator = native_simulator;
+    model->owner = owner;
+    int m = native_simulator.moments;
+    model->targets = model_vector(settings, "targets");
+    model->scale.assign(m, 1.0);
+    if (settings.containsElementNamed("weights")) {
+        model->scale = model_vector(settings, "weights");
+        for (size_t j = 0; j < model->scale.size(); ++j) {
+            model->scale[j] = sqrt(model->scale[j]);
+        }
+    }
+    model->replications = model_size(settings, "replications");
+    if ((int) model->targets.size() != m || (int) model->scale.size() != m || model->replications < 1 ||
+        native_simulator.draws < 1) {
+        smm_destroy(model);
+        stop("the simulator needs one target and weight per moment, at least one replication and one draw.");
+    }
+    int threads = std::max(model_size(settings, "threads"), 1);
+    model->pool = threads > 1 ? pool_create(threads) : NULL;
+    model->error.resize(threads);
+    model->moments.resize((size_t) model->replications * m);
+
+    // Generate the common random numbers
+    size_t count = (size_t) model->replications * native_simulator.draws;
+    void *arena = NULL;
+    if (posix_memalign(&arena, ARENA_ALIGNMENT, count * sizeof(PetscReal)) != 0) {
+        smm_destroy(model);
+        stop("cannot allocate the draws.");
+    }
+    model->arena = (PetscReal *) arena;
+    std::mt19937_64 random((unsigned long) model_size(settings, "seed"));
+    if (as<string>(settings["distribution"]) == "uniform") {
+        std::uniform_real_distribution<PetscReal> distribution(0.0, 1.0);
+        std::generate(model->arena, model->arena + count, [&]() { return distribution(random); });
+    } else {
+        std::normal_distribution<PetscReal> distribution(0.0, 1.0);
+        std::generate(model->arena, model->arena + count, [&]() { return distribution(random); });
+    }
+
+    Native *native = new Native();
+    native->objfun = smm_objective;
+    native->sepfun = smm_residuals;
+    native->n = m;
+    native->moments = 1;
+    native->data = model;
+    native->destroy = smm_destroy;
+    return wrap_native(native);
+}
@@ -0,0 +1,353 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+#include <taoR.h>
+#include "utils.h"
+#include "evaluate.h"
+#include "checkpoint.h"
+#include "progress.h"
+#include "budget.h"
+#include "history.h"
+#include "latency.h"
+#include "trace.h"
+#include "replay.h"
+#include "sum.h"
+#include "minibatch.h"
+#include "covariance.h"
+#include "solver.h"
+
+// Sets up a new solver, solver_create destroys it if this fails
+static PetscErrorCode solver_setup(Solver *solver, List functions, NumericVector start_values,
+                                   String method, int n,
+                                   NumericVector lower_bounds, NumericVector upper_bounds,
+                                   List settings) {
+
+    Problem &problem = solver->problem;
+
+    PetscFunctionBegin;
+
+    // Read in problem dimensions
+    problem.n = n;
+    problem.k = start_values.size();
+
+    if (functions.containsElementNamed("native")) {
+
+        // Native objectives are evaluated without calling R
+        XPtr<Native> native(functions["native"]);
+        problem.native = native.get();
+
+    } else {
+
+        // Read in the objective function
+        // Add it to problem context
+        problem.objfun = new Function(functions["objfun"]);
+
+        // Check whether we need to read in the jacobian
+        // to the problem context.
+        if (functions.containsElementNamed("grafun")) {
+            problem.grafun = new Function(functions["grafun"]);
+        }
+
+        // Check whether we need to read in the hessian
+        // to the problem context.
+        if (functions.containsElementNamed("hesfun")) {
+            problem.hesfun = new Function(functions["hesfun"]);
+        }
+    }
+
+    if (settings.containsElementNamed("quiet")) {
+        problem.quiet = as<bool>(settings["quiet"]);
+    }
+    
+    // Start with a stochastic phase on blocks of rows of a sum of terms
+    if (settings.containsElementNamed("minibatch")) {
+        if (sum_rows(problem.native) < 0) {
+            stop("minibatch requires a sum of terms, see tao_sum.");
+        }
+        if (sum_rows(problem.native) < 3) {
+            warning("the sum has too few rows to sample, the stochastic phase is skipped.");
+        }
+        problem.minibatch = minibatch_create(settings["minibatch"]);
+    }
+
+    // Compute the curvature at the solution for standard errors
+    if (settings.containsElementNamed("hessian")) {
+        string hessian = as<string>(settings["hessian"]);
+        bool separable = method == "pounders" || (problem.native != NULL && problem.native->sepfun != NULL);
+        problem.covariance = covariance_create(hessian, &problem, separable);
+    }
+
+    // Limit the time and the number of evaluations
+    problem.budget = budget_create(settings);
+    problem.latency = latency_create();
+
+    // Allocate vectors
+    catch_error(VecCreateSeq(MPI_COMM_SELF, start_values.size(), &solver->x));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, lower_bounds.size(), &solver->lb));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, upper_bounds.size(), &solver->ub));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, start_values.size(), &solver->ci));
+    catch_error(VecCreateSeq(MPI_COMM_SELF, n, &solver->f));
+
+    // Create TAO solver
+    catch_error(TaoCreate(PETSC_COMM_SELF, &solver->tao_context));
+    catch_error(TaoSetType(solver->tao_context, method.get_cstring()));
+
+    // Open the checkpoint. When resuming, the solve restarts from the
+    // starting values stored in the checkpoint and replays its evaluations.
+    if (settings.containsElementNamed("checkpoint")) {
+        String path = settings["checkpoint"];
+        int every = settings["checkpoint_every"];
+        problem.checkpoint = checkpoint_open(path, every, solver->method, start_values, n);
+    }
+
+    // Answer evaluations from the trace of an earlier solve, which is read
+    // before a new trace may replace it
+    if (settings.containsElementNamed("replay")) {
+        String path = settings["replay"];
+        double tolerance = settings.containsElementNamed("replay_tolerance") ? as<double>(settings["replay_tolerance"]) : 0;
+        problem.replay = replay_open(path, problem.k, n, tolerance);
+    }
+
+    // Trace every evaluation to a file
+    if (settings.containsElementNamed("trace")) {
+        String path = settings["trace"];
+        problem.trace = trace_open(path, problem.k, n);
+        if (problem.trace == NULL) {
+            stop("cannot create trace file.");
+        }
+    }
+
+    // Publish the progress to a file that other processes can read
+    if (settings.containsElementNamed("progress")) {
+        String path = settings["progress"];
+        problem.progress = progress_map(path, problem.k, PROGRESS_CREATE);
+        if (problem.progress == NULL) {
+            stop("cannot create progress file.");
+        }
+    }
+
+    // Form starting values and define functions
+    if (problem.checkpoint != NULL) {
+        catch_error(create_vec(solver->x, NumericVector(problem.checkpoint->x0.begin(), problem.checkpoint->x0.end())));
+    } else {
+        catch_error(create_vec(solver->x, start_values));
+    }
+    catch_error(TaoSetInitialVector(solver->tao_context, solver->x));
+
+    // Form lower, upper bounds vectors
+    catch_error(create_vec(solver->lb, lower_bounds));
+    catch_error(create_vec(solver->ub, upper_bounds));
+    catch_error(create_vec(solver->ci, problem.k));
+
+    // Create a matrix to hold hessians
+    catch_error(MatCreate(PETSC_COMM_SELF, &solver->H));
+    catch_error(MatSetSizes(solver->H, PETSC_DECIDE, PETSC_DECIDE, problem.k, problem.k));
+    catch_error(MatSetUp(solver->H));
+
+    // Define objective functions, gradients and hessians
+    catch_error(set_callbacks(solver->tao_context, &problem, method == "pounders", solver->f, solver->H));
+
+    // Set variable bounds
+    catch_error(TaoSetVariableBounds(solver->tao_context, solver->lb, solver->ub));
+
+    // Define monitor
+    catch_error(TaoSetMonitor(solver->tao_context, my_monitor, &problem, NULL));
+
+    // Apply the options of this solve
+    catch_error(options_apply(solver->options.get(), solver->tao_context, solver->prefix));
+
+    // Record the convergence history, its length depends on the options
+    if (settings.containsElementNamed("history") && as<bool>(settings["history"])) {
+        catch_error(history_create(&problem.history, solver->tao_context, problem.k));
+    }
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode solver_create(Solver **solver_out, List functions, NumericVector start_values,
+                             String method, List options, int n,
+                             NumericVector lower_bounds, NumericVector upper_bounds,
+                             List settings) {
+
+    PetscErrorCode error_code;
+
+    PetscFunctionBegin;
+    if (async_running()) {
+        stop("another solve is running in the background, wait for it to finish first.");
+    }
+
+    // Redirect output to the R console
+    PetscVFPrintf = print_to_rcout;
+
+    // Initialize PETSc
+    initialize();
+
+    // Parse the options before anything is allocated, they may be invalid
+    std::shared_ptr<const OptionSet> option_set = options_parse(options);
+
+    if(method != "pounders") {
+        if(n > 1)  {
+            stop("n must be equal 1 unless you are using Pounders.");
+        }
+    }
+
+    Solver *solver = new Solver();
+    solver->method = method.get_cstring();
+    solver->options = option_set;
+    solver->prefix = options_prefix();
+
+    // Invalid settings stop with an R error, either way nothing may leak
+    try {
+        error_code = solver_setup(solver, functions, start_values, method, n,
+                                  lower_bounds, upper_bounds, settings);
+    } catch (...) {
+        solver_destroy(solver);
+        throw;
+    }
+    if (error_code != 0) {
+        solver_destroy(solver);
+    }
+    catch_error(error_code);
+
+    *solver_out = solver;
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode solver_solve(Solver *solver) {
+
+    PetscFunctionBegin;
+    progress_set_status(solver->problem.progress, PROGRESS_RUNNING);
+
+    // Perform the Solve. Once the budget is exhausted, the callbacks unwind
+    // TaoSolve with BUDGET_EXHAUSTED, which is not an error.
+    {
+        BudgetHandlerScope handler(solver->problem.budget);
+        solver->error = minibatch_run(solver->problem.minibatch, &solver->problem, solver->tao_context,
+                                      solver->x, solver->lb, solver->ub);
+        
+        // The solve polishes the result of the stochastic phase on all rows,
+        // unless the phase used up the budget. A cancelled solve stops at
+        // the first iteration.
+        if (solver->error == 0 && solver->problem.budget->exhausted == BUDGET_AVAILABLE) {
+            solver->error = TaoSolve(solver->tao_context);
+        }
+    }
+    if (solver->error == BUDGET_EXHAUSTED && solver->problem.budget->exhausted != BUDGET_AVAILABLE) {
+        solver->error = 0;
+    }
+    if (solver->error != 0) {
+        progress_set_status(solver->problem.progress, PROGRESS_FAILED);
+        PetscFunctionReturn(solver->error);
+    }
+
+    // Write the final state to the checkpoint
+    catch_error(checkpoint_write(solver->problem.checkpoint, solver->tao_context));
+    catch_error(progress_update(solver->problem.progress, solver->tao_context, solver->problem.budget));
+    progress_set_status(solver->problem.progress,
+                        progress_cancelled(solver->problem.progress) ? PROGRESS_CANCELLED : PROGRESS_FINISHED);
+    PetscFunctionReturn(0);
+}
+
+List solver_result(Solver *solver) {
+
+    Problem &problem = solver->problem;
+    PetscReal fc, gnorm, cnorm, xdiff;
+    PetscInt its;
+    PetscErrorCode error_code = 0;
+
+    if (!problem.quiet) {
+        error_code = TaoView(solver->tao_context, PETSC_VIEWER_STDOUT_SELF);
+    }
+    if (error_code == 0) {
+        error_code = TaoGetSolutionStatus(solver->tao_context, &its, &fc, &gnorm, &cnorm, &xdiff, 0);
+    }
+    if (error_code != 0) {
+        stop("cannot read the result of the solve, PETSc error code %d.", error_code);
+    }
+
+    NumericVector xVec(problem.k);
+    xVec = get_vec(solver->x, problem.k);
+
+    NumericVector fVec(problem.n);
+    if(solver->method == "pounders") {
+        fVec = get_vec(solver->f, problem.n);
+    } else {
+        fVec[0] = fc;
+    }
+
+    // A solve that was stopped early returns the best point seen so far
+    Budget *budget = problem.budget;
+    if (budget->exhausted != BUDGET_AVAILABLE && !budget->best_x.empty()) {
+        xVec = NumericVector(budget->best_x.begin(), budget->best_x.end());
+        if(solver->method == "pounders") {
+            fVec = NumericVector(budget->best_y.begin(), budget->best_y.end());
+        } else {
+            fVec[0] = budget->best_f;
+        }
+    }
+
+    // The curvature is evaluated at the returned solution
+    List hessian;
+    if (problem.covariance != NULL) {
+        hessian = covariance_compute(problem.covariance, &problem, xVec, solver->H);
+    }
+
+    return List::create(
+        Named("x")  = xVec,
+        Named("f")  = fVec,
+        Named("iterations")  = its,
+        Named("gnorm")  = gnorm,
+        Named("cnorm")  = cnorm,
+        Named("xdiff")  = xdiff,
+        Named("reason")  = budget_reason(budget, solver->tao_context),
+        Named("evaluations")  = (double) budget->evaluations,
+        Named("elapsed")  = budget_elapsed(budget),
+        Named("callbacks")  = latency_read(problem.latency),
+        Named("history")  = problem.history != NULL ? (SEXP) history_read(problem.history, solver->tao_context) : R_NilValue,
+        Named("replay")  = problem.replay != NULL ? (SEXP) replay_read(problem.replay) : R_NilValue,
+        Named("minibatch")  = problem.minibatch != NULL ? (SEXP) minibatch_read(problem.minibatch) : R_NilValue,
+        Named("hessian")  = problem.covariance != NULL ? (SEXP) hessian : R_NilValue
+    );
+}
+
+void solver_destroy(Solver *solver) {
+
+    Problem &problem = solver->problem;
+
+    // Free TAO data structures
+    TaoDestroy(&solver->tao_context);
+    MatDestroy(&solver->H);
+    VecDestroy(&solver->x);
+    VecDestroy(&solver->f);
+    VecDestroy(&solver->lb);
+    VecDestroy(&solver->ub);
+    VecDestroy(&solver->ci);
+
+    options_clear(solver->options.get(), solver->prefix);
+    checkpoint_close(problem.checkpoint);
+    progress_close(problem.progress);
+    budget_destroy(problem.budget);
+    history_destroy(problem.history);
+    latency_destroy(problem.latency);
+    trace_close(problem.trace);
+    replay_close(problem.replay);
+    minibatch_destroy(problem.minibatch);
+    covariance_destroy(problem.covariance);
+    delete problem.objfun;
+    delete problem.grafun;
+    delete problem.hesfun;
+    delete solver;
+}
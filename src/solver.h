@@ -0,0 +1,89 @@
+#ifndef solver_h
+#define solver_h
+
+#include "taoR.h"
+#include "options.h"
+
+// A TAO solver together with its problem context and PETSc objects. Solvers
+// are created and destroyed on the R thread; solver_solve does not call into R
+// unless the objective function is an R function, so that solves of native
+// objectives can run on another thread.
+struct Solver {
+    Problem problem;
+    string method;
+    Tao tao_context;
+    Vec x, f, lb, ub, ci;
+    Mat H;
+    PetscErrorCode error;
+    std::shared_ptr<const OptionSet> options;
+    string prefix;
+};
+
+// Creates a solver: reads in the functions, creates the PETSc objects, sets
+// the callbacks, bounds and monitor, and applies the options under an options
+// prefix that is unique to the solver. If this fails, everything that was
+// created is destroyed again.
+//
+// @param solver Receives the new solver.
+// @param functions is a list with the objective function (objfun) and
+//        optionally the gradient (grafun) and Hessian (hesfun), or a native
+//        objective (native).
+// @param start_values is a vector containing the starting values.
+// @param method is the TAO method.
+// @param options is a list containing option values for the optimizer.
+// @param n is the number of elements in the objective function.
+// @param lower_bounds is a vector with lower bounds.
+// @param upper_bounds is a vector with upper bounds.
+// @param settings is a list with settings that are not passed to PETSc.
+// @returns Error code.
+PetscErrorCode solver_create(Solver **solver, List functions, NumericVector start_values,
+                             String method, List options, int n,
+                             NumericVector lower_bounds, NumericVector upper_bounds,
+                             List settings);
+
+// Runs TaoSolve and records the final state in the checkpoint and progress.
+//
+// @param solver The solver.
+// @returns Error code.
+PetscErrorCode solver_solve(Solver *solver);
+
+// Collects the result of a solve.
+//
+// @param solver The solver.
+// @returns A list with x, f, iterations, gnorm, cnorm, xdiff, the reason for
+//          which the solve stopped, the number of evaluations, the elapsed
+//          time, the calls of each callback and the convergence history, if
+//          it was recorded. A solve that exhausted its budget returns the best
+//          point seen.
+List solver_result(Solver *solver);
+
+// Destroys the solver and all its PETSc objects.
+//
+// @param solver The solver.
+void solver_destroy(Solver *solver);
+
+// Destroys a solver when the scope ends, such that its PETSc objects are also
+// freed if a function returns early on an error or R throws an exception.
+class SolverScope {
+public:
+    explicit SolverScope(Solver *solver) : solver(solver) {}
+    ~SolverScope() {
+        if (solver != NULL) {
+            solver_destroy(solver);
+        }
+    }
+    // Destroys the solver now, before the scope ends.
+    void destroy() {
+        Solver *destroyed = solver;
+        solver = NULL;
+        solver_destroy(destroyed);
+    }
+private:
+    Solver *solver;
+};
+
+// Whether a solve is running on another thread, in which case no other solve
+// may use PETSc.
+bool async_running();
+
+#endif
@@ -0,0 +1,267 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <algorithm>
+#include "native.h"
+#include "pool.h"
+#include "sum.h"
+
+// A sum of terms with one accumulator per thread.
+struct SumObjective {
+    NativeSum sum;
+    RObject owner;
+    ThreadPool *pool;
+    vector<PetscReal> f, g, h;
+    vector<int> error;
+};
+
+static PetscErrorCode sum_check(int k, SumObjective *model) {
+    PetscFunctionBegin;
+    if (model->sum.k > 0 && k != model->sum.k) {
+        SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Expected %d parameters, got %d", model->sum.k, k);
+    }
+    PetscFunctionReturn(0);
+}
+
+// the first error of any thread
+static PetscErrorCode sum_error(SumObjective *model) {
+    PetscFunctionBegin;
+    for (size_t t = 0; t < model->error.size(); ++t) {
+        if (model->error[t] != 0) {
+            SETERRQ2(PETSC_COMM_SELF, PETSC_ERR_LIB, "The terms of thread %d failed with error %d",
+                     (int) t, model->error[t]);
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+// evaluates f and, unless g is NULL, the gradient
+static PetscErrorCode sum_evaluate(int k, const PetscReal *x, PetscReal *f, PetscReal *g, SumObjective *model) {
+
+    PetscFunctionBegin;
+    catch_error(sum_check(k, model));
+    int threads = pool_threads(model->pool);
+    model->g.resize((size_t) threads * k);
+
+    pool_run(model->pool, [&](int thread) {
+        PetscReal *thread_f = &model->f[thread];
+        PetscReal *thread_g = g != NULL ? &model->g[(size_t) thread * k] : NULL;
+        long begin, end;
+        pool_share(model->sum.rows, threads, thread, &begin, &end);
+        *thread_f = 0.0;
+        if (thread_g != NULL) {
+            std::fill(thread_g, thread_g + k, 0.0);
+        }
+        model->error[thread] = 0;
+        for (long block = begin; block < end && model->error[thread] == 0; block += SUM_BLOCK) {
+            model->error[thread] = model->sum.terms(k, x, block, std::min(block + SUM_BLOCK, end), thread_f, thread_g,
+                                                    model->sum.data);
+        }
+    });
+    catch_error(sum_error(model));
+
+    // Combine in the order of the threads
+    *f = 0.0;
+    if (g != NULL) {
+        std::fill(g, g + k, 0.0);
+    }
+    for (int t = 0; t < threads; ++t) {
+        *f += model->f[t];
+        for (int i = 0; g != NULL && i < k; ++i) {
+            g[i] += model->g[(size_t) t * k + i];
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode sum_objective(int k, const PetscReal *x, PetscReal *f, void *data) {
+    PetscFunctionBegin;
+    catch_error(sum_evaluate(k, x, f, NULL, (SumObjective *) data));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode sum_gradient(int k, const PetscReal *x, int n, PetscReal *g, void *data) {
+    PetscReal f;
+    PetscFunctionBegin;
+    catch_error(sum_evaluate(k, x, &f, g, (SumObjective *) data));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode sum_objective_gradient(int k, const PetscReal *x, PetscReal *f, PetscReal *g, void *data) {
+    PetscFunctionBegin;
+    catch_error(sum_evaluate(k, x, f, g, (SumObjective *) data));
+    PetscFunctionReturn(0);
+}
+
+static PetscErrorCode sum_hessian(int k, const PetscReal *x, int n, PetscReal *h, void *data) {
+
+    SumObjective *model = (SumObjective *) data;
+
+    PetscFunctionBegin;
+    catch_error(sum_check(k, model));
+    int threads = pool_threads(model->pool);
+    size_t size = (size_t) k * k;
+    model->h.resize(threads * size);
+
+    pool_run(model->pool, [&](int thread) {
+        PetscReal *thread_h = &model->h[thread * size];
+        long begin, end;
+        pool_share(model->sum.rows, threads, thread, &begin, &end);
+        std::fill(thread_h, thread_h + size, 0.0);
+        model->error[thread] = 0;
+        for (long block = begin; block < end && model->error[thread] == 0; block += SUM_BLOCK) {
+            model->error[thread] = model->sum.hesterms(k, x, block, std::min(block + SUM_BLOCK, end), thread_h,
+                                                       model->sum.data);
+        }
+    });
+    catch_error(sum_error(model));
+
+    std::fill(h, h + size, 0.0);
+    for (int t = 0; t < threads; ++t) {
+        for (size_t i = 0; i < size; ++i) {
+            h[i] += model->h[t * size + i];
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+long sum_rows(Native *native) {
+    if (native == NULL || native->objfun != sum_objective) {
+        return -1;
+    }
+    return ((SumObjective *) native->data)->sum.rows;
+}
+
+PetscErrorCode sum_evaluate_blocks(Native *native, int k, const PetscReal *x, long block,
+                                   const vector<long> &blocks, PetscReal *f, PetscReal *g) {
+
+    SumObjective *model = (SumObjective *) native->data;
+
+    PetscFunctionBegin;
+    catch_error(sum_check(k, model));
+    int threads = pool_threads(model->pool);
+    pool_run(model->pool, [&](int thread) {
+        long first, last;
+        pool_share(blocks.size(), threads, thread, &first, &last);
+        model->error[thread] = 0;
+        for (long b = first; b < last && model->error[thread] == 0; ++b) {
+            long begin = blocks[b] * block;
+            long end = std::min(begin + block, model->sum.rows);
+            f[b] = 0.0;
+            std::fill(g + b * k, g + (b + 1) * k, 0.0);
+            model->error[thread] = model->sum.terms(k, x, begin, end, &f[b], g + b * k, model->sum.data);
+        }
+    });
+    catch_error(sum_error(model));
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode sum_outer_gradients(Native *native, int k, const PetscReal *x, PetscReal *meat) {
+
+    SumObjective *model = (SumObjective *) native->data;
+
+    PetscFunctionBegin;
+    catch_error(sum_check(k, model));
+    int threads = pool_threads(model->pool);
+    size_t size = (size_t) k * k;
+    model->h.resize(threads * size);
+
+    pool_run(model->pool, [&](int thread) {
+        PetscReal *thread_h = &model->h[thread * size];
+        vector<PetscReal> g(k);
+        PetscReal f;
+        long begin, end;
+        pool_share(model->sum.rows, threads, thread, &begin, &end);
+        std::fill(thread_h, thread_h + size, 0.0);
+        model->error[thread] = 0;
+        for (long row = begin; row < end && model->error[thread] == 0; ++row) {
+            f = 0.0;
+            std::fill(g.begin(), g.end(), 0.0);
+            model->error[thread] = model->sum.terms(k, x, row, row + 1, &f, &g[0], model->sum.data);
+            for (int i = 0; i < k; ++i) {
+                for (int j = 0; j < k; ++j) {
+                    thread_h[i * k + j] += g[i] * g[j];
+                }
+            }
+        }
+    });
+    catch_error(sum_error(model));
+
+    std::fill(meat, meat + size, 0.0);
+    for (int t = 0; t < threads; ++t) {
+        for (size_t i = 0; i < size; ++i) {
+            meat[i] += model->h[t * size + i];
+        }
+    }
+    PetscFunctionReturn(0);
+}
+
+static void sum_destroy(void *data) {
+    SumObjective *model = (SumObjective *) data;
+    pool_destroy(model->pool);
+    if (model->sum.destroy != NULL) {
+        model->sum.destroy(model->sum.data);
+    }
+    delete model;
+}
+
+Native *sum_create(const NativeSum &sum, SEXP owner, int threads) {
+
+    threads = std::max(threads, 1);
+    SumObjective *model = new SumObjective();
+    model->sum = sum;
+    model->owner = owner;
+    if (owner != R_NilValue) {
+        model->sum.destroy = NULL;
+    }
+    model->pool = threads > 1 ? pool_create(threads) : NULL;
+    model->f.resize(threads);
+    model->error.resize(threads);
+
+    Native *native = new Native();
+    native->objfun = sum_objective;
+    native->grafun = sum_gradient;
+    native->objgrad = sum_objective_gradient;
+    native->hesfun = sum.hesterms != NULL ? sum_hessian : NULL;
+    native->n = 1;
+    native->data = model;
+    native->destroy = sum_destroy;
+    return native;
+}
+
+//' Create a native objective from a sum of terms
+//'
+//' \code{tao_sum_cpp} is an internal function of this package. It is recommended
+//' that users call \code{\link{tao_sum}} instead.
+//'
+//' @param terms is an external pointer of class \code{tao_sum} to a
+//'        \code{NativeSum}.
+//' @param threads is the number of threads.
+//' @return an external pointer of class \code{tao_native}
+// [[Rcpp::export]]
+SEXP tao_sum_cpp(SEXP terms, int threads) {
+    if (!Rf_inherits(terms, "tao_sum")) {
+        stop("terms must be an external pointer of class tao_sum.");
+    }
+    XPtr<NativeSum> sum(terms);
+    if (sum.get() == NULL || sum->terms == NULL) {
+        stop("the sum of terms has no kernel.");
+    }
+    return wrap_native(sum_create(*sum, terms, threads));
+}
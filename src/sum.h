@@ -0,0 +1,53 @@
+#ifndef sum_h
+#define sum_h
+
+#include "taoR.h"
+
+// Turns a sum of terms into a native objective that evaluates the kernels in
+// parallel. The rows are split into one contiguous range per thread, each
+// thread accumulates its range into its own f, g and h in blocks of rows, and
+// the threads' sums are added in the order of the threads, so a solve with
+// the same number of threads gives the same result every time.
+//
+// @param sum The kernels. If owner is NULL, the native objective owns their
+//        data and destroys it; otherwise owner is kept alive instead.
+// @param owner The R object that owns the kernels, may be R_NilValue.
+// @param threads The number of threads.
+// @returns The native objective.
+Native *sum_create(const NativeSum &sum, SEXP owner, int threads);
+
+// The number of rows per call of a kernel. The rows of a sum are also
+// sampled in blocks of at most this many rows.
+static const long SUM_BLOCK = 4096;
+
+// Returns the number of rows of a native objective that is a sum of terms,
+// or -1 if it is not.
+long sum_rows(Native *native);
+
+// Evaluates the terms and their gradient of some blocks of rows, each block
+// into its own slot. The threads split the blocks between them, so the sums
+// do not depend on the number of threads.
+//
+// @param native A sum of terms.
+// @param k The number of parameters.
+// @param x The parameters.
+// @param block The number of rows per block, at most SUM_BLOCK.
+// @param blocks The indices of the blocks.
+// @param f Receives the sum of the terms of each block.
+// @param g Receives the gradient of each block, k values per block.
+// @returns Error code.
+PetscErrorCode sum_evaluate_blocks(Native *native, int k, const PetscReal *x, long block,
+                                   const vector<long> &blocks, PetscReal *f, PetscReal *g);
+
+// Adds up the outer products of the gradients of the single rows, the meat of
+// a sandwich covariance. The threads split the rows as in a solve and their
+// sums are added in the order of the threads.
+//
+// @param native A sum of terms.
+// @param k The number of parameters.
+// @param x The parameters.
+// @param meat Receives the k x k sum.
+// @returns Error code.
+PetscErrorCode sum_outer_gradients(Native *native, int k, const PetscReal *x, PetscReal *meat);
+
+#endif
@@ -16,8 +16,9 @@
 //  GNU General Public License for more details.
 
 #include <taoR.h>
-#include "utils.h"
-#include "evaluate.h"
+#include "solver.h"
+#include "logging.h"
+#include "memory.h"
 
 //' Use TAO to minimize an objective function
 //' 
@@ -27,14 +28,36 @@
 //'
 //' @param functions is a list of Rcpp functions. The first is always the objective 
 //'        function. The second and third are optionally the Jacobian and the Hessian 
-//'        functions.
+//'        functions. Alternatively, the list contains a native objective function.
 //' @param start_values is a vector containing the starting values of the parameters.
 //' @param method is a string that determines the type of optimizer to be used.
 //' @param options is a list containing option values for the optimizer
 //' @param n is the number of elements in the objective function.
 //' @param lower_bounds is a vector with lower bounds
 //' @param upper_bounds is a vector with upper bounds
-//' @return a list with the objective function and the final parameter values
+//' @param settings is a list with settings that are not passed to PETSc:
+//'        \code{checkpoint} is the path of a checkpoint file and
+//'        \code{checkpoint_every} the number of iterations between checkpoints,
+//'        \code{quiet} suppresses all output, \code{history} records the
+//'        convergence history, \code{trace} is the path of a file to which
+//'        every evaluation is written, \code{progress} is the path of a
+//'        file to which the progress is published, and \code{max_time} and
+//'        \code{max_evaluations} limit the time in seconds and the number
+//'        of evaluations, \code{replay} is the path of a trace whose
+//'        evaluations are fed back within \code{replay_tolerance},
+//'        \code{leak_check} stops with an error if any PETSc object outlives
+//'        the solve, \code{minibatch} is a list of settings of a
+//'        stochastic phase before the solve of a sum of terms, and
+//'        \code{hessian} is the method of the curvature at the solution,
+//'        \code{"final"}, \code{"fd"} or \code{"gn"}.
+//' @return a list with the objective function and the final parameter values,
+//'         and the \code{profile} of the solve: the number of calls, the time
+//'         and the flops of each PETSc event in the setup, solve and teardown
+//'         stages, and the \code{memory} usage of the solve. With
+//'         \code{hessian}, the \code{hessian} list holds the \code{method}
+//'         that was used, the \code{hessian} or its \code{inverse}, the
+//'         \code{meat} of a sandwich covariance, the \code{type} of the
+//'         problem and the number of \code{residuals}.
 //' @examples
 //' # use pounders
 //' objfun = function(x) c((x[1] - 3), (x[2] + 1))
@@ -64,152 +87,62 @@ List tao_cpp(List functions,
          List options, 
          int n, 
          NumericVector lower_bounds,
-         NumericVector upper_bounds) {
+         NumericVector upper_bounds,
+         List settings = List::create()) {
 
-    // Redirect output to the R console
-    PetscVFPrintf = print_to_rcout;
-    
-    // Initialize PETSc
-    initialize(options);
-    
-    // Problem-defined work context 
-    Problem problem; 
-    
-    // Read in problem dimensions
-    problem.n = n;
-    problem.k = start_values.size();
-    
-    // use_grafun, use_hesfun
-    bool use_grafun = false, use_hesfun = false;
-    
-    if(method != "pounders") {
-        if(n > 1)  {
-            stop("n must be equal 1 unless you are using Pounders.");
-        }
-    }
-    
-    // Read in the objective function
-    // Add it to problem context
-    Function objfun = functions["objfun"];
-    problem.objfun = &objfun;
-    
-    // Check whether we need to read in the jacobian
-    // to the problem context.
-    Function grafun = functions["objfun"];
-    if (functions.containsElementNamed("grafun")) {
-        grafun = functions["grafun"];
-        use_grafun = true;
-        problem.grafun = &grafun;
+    // PETSc is not thread-safe, the snapshots below already read its logs
+    if (async_running()) {
+        stop("another solve is running in the background, wait for it to finish first.");
     }
-    
-    // Check whether we need to read in the hessian
-    // to the problem context.
-    Function hesfun = functions["objfun"];
-    if (functions.containsElementNamed("hesfun")) {
-        hesfun = functions["hesfun"];
-        use_hesfun = true;
-        problem.hesfun = &hesfun;
-    }
-    
-    Vec x, f; // solution, function
-    Vec ub, lb, ci; // upper and lower bounds
-    Tao tao_context; // Tao solver context 
-    PetscReal fc, gnorm, cnorm, xdiff;
-    PetscInt its;
 
-    // Allocate vectors
-    catch_error(VecCreateSeq(MPI_COMM_SELF, start_values.size(), &x));
-    catch_error(VecCreateSeq(MPI_COMM_SELF, lower_bounds.size(), &lb));
-    catch_error(VecCreateSeq(MPI_COMM_SELF, upper_bounds.size(), &ub));
-    catch_error(VecCreateSeq(MPI_COMM_SELF, start_values.size(), &ci));
-    catch_error(VecCreateSeq(MPI_COMM_SELF, n, &f));
-    
-    // Create TAO solver
-    catch_error(TaoCreate(PETSC_COMM_SELF, &tao_context));
-    catch_error(TaoSetType(tao_context, method.get_cstring()));
-    
-    // Form starting values and define functions
-    catch_error(create_vec(x, start_values));
-    catch_error(TaoSetInitialVector(tao_context, x));
-    
-    // Form lower, upper bounds vectors
-    catch_error(create_vec(lb, lower_bounds));
-    catch_error(create_vec(ub, upper_bounds));
-    catch_error(create_vec(ci, problem.k));
+    Solver *solver;
+    LogSnapshot snapshot = logging_snapshot();
+    MemoryUsage memory = memory_snapshot();
+    bool leak_check = settings.containsElementNamed("leak_check") && as<bool>(settings["leak_check"]);
+    
+    List result;
+    PetscErrorCode error_code;
+    try {
+        // Set up the solver and perform the solve
+        {
+            LogStageScope log_stage(TAOR_Setup);
+            error_code = solver_create(&solver, functions, start_values, method, options, n,
+                                       lower_bounds, upper_bounds, settings);
+        }
+        
+        // The solver is destroyed on every exit, also if a callback fails
+        if (error_code == 0) {
+            SolverScope scope(solver);
+            {
+                LogStageScope log_stage(TAOR_Solve);
+                error_code = solver_solve(solver);
+            }
 
-/*        
-    // Check whether lower / upper bounds inequalities have been set
-    Function inequal = functions["objfun"];
-    if (functions.containsElementNamed("inequal")) {
-        inequal = functions["inequal"];
-        problem.inequal = &inequal;
-        catch_error(TaoSetInequalityConstraintsRoutine(tao_context, ci, evaluate_inequalities, &problem));
-    }
-    
-    // Check whether lower / upper bounds equalities have been set
-    Function equal = functions["objfun"];
-    if (functions.containsElementNamed("equal")) {
-        equal = functions["equal"];
-        problem.equal = &equal;
-        catch_error(TaoSetConstraintsRoutine(tao_context, ci, evaluate_equalities, &problem));
-    }
-*/    
-    // Create a matrix to hold hessians
-    Mat H;
-    MatCreate(PETSC_COMM_WORLD, &H);
-    MatSetSizes(H, PETSC_DECIDE, PETSC_DECIDE, problem.k, problem.k);
-    MatSetUp(H);
-    
-    // Define objective functions and gradients
-    if(method == "pounders") {
-        catch_error(TaoSetSeparableObjectiveRoutine(tao_context, f, evaluate_objective_separable, (void*)&problem));
-    } else {
-        catch_error(TaoSetObjectiveRoutine(tao_context, evaluate_objective, (void*)&problem));
-    }
-    
-    if (use_grafun) {
-        catch_error(TaoSetGradientRoutine(tao_context, evaluate_gradient, (void*)&problem));
+            LogStageScope log_stage(TAOR_Teardown);
+            if (error_code == 0) {
+                result = solver_result(solver);
+            }
+            scope.destroy();
+        }
+    } catch (...) {
+        // A failed solve reports its own error, unless it leaked
+        if (leak_check) {
+            memory_check_leaks(memory);
+        }
+        throw;
     }
-    
-    if (use_hesfun) {
-        catch_error(TaoSetHessianRoutine(tao_context, H, H, evaluate_hessian, (void*)&problem));
+    if (error_code != 0) {
+        if (leak_check) {
+            memory_check_leaks(memory);
+        }
+        stop("the solve failed with PETSc error code %d.", error_code);
     }
-    
-    // Set variable bounds
-    catch_error(TaoSetVariableBounds(tao_context, lb, ub));
-    
-    // Define monitor
-    catch_error(TaoSetMonitor(tao_context, my_monitor, &problem, NULL));
-    
-    // Check for any TAO command line arguments 
-    catch_error(TaoSetFromOptions(tao_context));
-    
-    // Perform the Solve
-    catch_error(TaoSolve(tao_context));
-    catch_error(TaoView(tao_context, PETSC_VIEWER_STDOUT_SELF));
-    catch_error(TaoGetSolutionStatus(tao_context, &its, &fc, &gnorm, &cnorm, &xdiff, 0));
-    
-    // Free TAO data structures
-    catch_error(TaoDestroy(&tao_context));
-    NumericVector xVec(start_values.size());
-    xVec = get_vec(x, start_values.size());
-    catch_error(VecDestroy(&x));
-    
-    NumericVector fVec(n);
-    if(method == "pounders") {
-        fVec = get_vec(f, n);
-        catch_error(VecDestroy(&f));
-    } else {
-        fVec[0] = fc;
+    result.push_back(logging_profile(snapshot), "profile");
+    result.push_back(memory_report(memory), "memory");
+
+    // Fail if any PETSc object of the solve was not destroyed
+    if (leak_check) {
+        memory_check_leaks(memory);
     }
-    
-    return List::create( 
-        Named("x")  = xVec,
-        Named("f")  = fVec,
-        Named("iterations")  = its,
-        Named("gnorm")  = gnorm,
-        Named("cnorm")  = cnorm,
-        Named("xdiff")  = xdiff
-    );
-    
+    return result;
 }
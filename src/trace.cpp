@@ -0,0 +1,321 @@
+//  taoR -- Toolkit for Advanced Optimization (TAO) Bindings for R
+//
+//  Copyright (C) 2015  Jan Tilly <jtilly@econ.upenn.edu>
+//                      Nick Janetos <njanetos@econ.upenn.edu>
+//
+//  This file is part of taoR.
+//
+//  taoR is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  taoR is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+
+#include <taoR.h>
+#include <fcntl.h>
+#include <math.h>
+#include <algorithm>
+#include <petsctime.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "trace.h"
+
+static const char TRACE_MAGIC[8] = {'t', 'a', 'o', 'R', 't', 'r', 'c', '\0'};
+static const int32_t TRACE_VERSION = 1;
+static const size_t TRACE_INITIAL_CAPACITY = 1024;
+
+static const char *TYPE_NAMES[] = {"objective", "gradient", "hessian", "separable"};
+
+static size_t trace_size(size_t record_size, size_t capacity) {
+    return sizeof(TraceHeader) + capacity * record_size;
+}
+
+static double *trace_records(TraceHeader *header) {
+    return (double *) (header + 1);
+}
+
+// maps a file with room for capacity records
+static TraceHeader *map_file(int fd, size_t size, int protection) {
+    void *memory = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    return memory == MAP_FAILED ? NULL : (TraceHeader *) memory;
+}
+
+Trace *trace_open(string path, int k, int n) {
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    int width = std::max(std::max(k, n), 1);
+    size_t record_size = (2 + k + width) * sizeof(double);
+    size_t size = trace_size(record_size, TRACE_INITIAL_CAPACITY);
+    TraceHeader *header = NULL;
+    if (ftruncate(fd, size) != 0 || (header = map_file(fd, size, PROT_READ | PROT_WRITE)) == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    memcpy(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header->version = TRACE_VERSION;
+    header->k = k;
+    header->width = width;
+    header->records = 0;
+
+    Trace *trace = new Trace();
+    trace->fd = fd;
+    trace->header = header;
+    trace->capacity = TRACE_INITIAL_CAPACITY;
+    trace->record_size = record_size;
+    PetscTime(&trace->start);
+    return trace;
+}
+
+// doubles the capacity of the file
+static PetscErrorCode trace_grow(Trace *trace) {
+
+    PetscFunctionBegin;
+    size_t old_size = trace_size(trace->record_size, trace->capacity);
+    size_t new_size = trace_size(trace->record_size, 2 * trace->capacity);
+    if (ftruncate(trace->fd, new_size) != 0) {
+        SETERRQ(PETSC_COMM_SELF, PETSC_ERR_FILE_WRITE, "Cannot grow the trace file");
+    }
+    TraceHeader *header = map_file(trace->fd, new_size, PROT_READ | PROT_WRITE);
+    if (header == NULL) {
+        SETERRQ(PETSC_COMM_SELF, PETSC_ERR_MEM, "Cannot map the trace file");
+    }
+    munmap(trace->header, old_size);
+    trace->header = header;
+    trace->capacity *= 2;
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode trace_record(Trace *trace, int type, Vec X, const PetscReal *values, int count) {
+
+    PetscLogDouble now;
+    const PetscReal *x;
+
+    PetscFunctionBegin;
+    if (trace == NULL) {
+        PetscFunctionReturn(0);
+    }
+    uint64_t records = trace->header->records;
+    if (records == trace->capacity) {
+        catch_error(trace_grow(trace));
+    }
+
+    int k = trace->header->k;
+    int width = trace->header->width;
+    double *record = trace_records(trace->header) + records * (2 + k + width);
+    catch_error(PetscTime(&now));
+    record[0] = now - trace->start;
+    record[1] = type;
+    catch_error(VecGetArrayRead(X, &x));
+    memcpy(record + 2, x, k * sizeof(double));
+    catch_error(VecRestoreArrayRead(X, &x));
+    for (int i = 0; i < width; ++i) {
+        record[2 + k + i] = i < count ? values[i] : NAN;
+    }
+
+    // publish the record
+    __atomic_store_n(&trace->header->records, records + 1, __ATOMIC_RELEASE);
+    PetscFunctionReturn(0);
+}
+
+PetscErrorCode trace_record(Trace *trace, int type, Vec X, Vec Y) {
+
+    const PetscReal *y;
+    PetscInt count;
+
+    PetscFunctionBegin;
+    if (trace == NULL) {
+        PetscFunctionReturn(0);
+    }
+    catch_error(VecGetLocalSize(Y, &count));
+    catch_error(VecGetArrayRead(Y, &y));
+    catch_error(trace_record(trace, type, X, y, count));
+    catch_error(VecRestoreArrayRead(Y, &y));
+    PetscFunctionReturn(0);
+}
+
+void trace_close(Trace *trace) {
+
+    if (trace == NULL) {
+        return;
+    }
+    size_t used = trace_size(trace->record_size, trace->header->records);
+    munmap(trace->header, trace_size(trace->record_size, trace->capacity));
+    if (ftruncate(trace->fd, used) != 0) {
+        // readers only rely on the header, unused capacity does no harm
+    }
+    close(trace->fd);
+    delete trace;
+}
+
+bool trace_valid(const TraceHeader *header) {
+    return memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0 && header->version == TRACE_VERSION;
+}
+
+// A trace file mapped for reading. It is mapped again when it has grown.
+struct TraceReader {
+    int fd;
+    TraceHeader *header;
+    size_t size;
+};
+
+static void reader_unmap(TraceReader *reader) {
+    if (reader->header != NULL) {
+        munmap(reader->header, reader->size);
+        reader->header = NULL;
+    }
+}
+
+// maps the whole file as it is now
+static bool reader_map(TraceReader *reader) {
+    struct stat info;
+    if (fstat(reader->fd, &info) != 0 || (size_t) info.st_size < sizeof(TraceHeader)) {
+        return false;
+    }
+    reader_unmap(reader);
+    reader->size = info.st_size;
+    reader->header = map_file(reader->fd, reader->size, PROT_READ);
+    return reader->header != NULL;
+}
+
+static void reader_finalizer(TraceReader *reader) {
+    reader_unmap(reader);
+    close(reader->fd);
+    delete reader;
+}
+
+// the number of complete records that are mapped, the file is mapped again
+// once it has grown
+static uint64_t reader_records(TraceReader *reader) {
+    if (reader->header == NULL && !reader_map(reader)) {
+        stop("cannot map trace file.");
+    }
+    TraceHeader *header = reader->header;
+    size_t record_size = (2 + header->k + header->width) * sizeof(double);
+    uint64_t records = __atomic_load_n(&header->records, __ATOMIC_ACQUIRE);
+    if (trace_size(record_size, records) > reader->size) {
+        if (!reader_map(reader)) {
+            stop("cannot map trace file.");
+        }
+        header = reader->header;
+        records = std::min((uint64_t) ((reader->size - sizeof(TraceHeader)) / record_size),
+                           (uint64_t) __atomic_load_n(&header->records, __ATOMIC_ACQUIRE));
+    }
+    return records;
+}
+
+//' Open a trace file for reading
+//'
+//' @param path is the path of the trace file.
+//' @return an external pointer to the mapped file
+// [[Rcpp::export]]
+SEXP tao_trace_open_cpp(String path) {
+
+    TraceReader *reader = new TraceReader();
+    reader->header = NULL;
+    reader->fd = open(path.get_cstring(), O_RDONLY);
+    if (reader->fd < 0 || !reader_map(reader) || !trace_valid(reader->header)) {
+        reader_finalizer(reader);
+        stop("cannot read trace file.");
+    }
+    XPtr<TraceReader, PreserveStorage, reader_finalizer> ptr(reader, true);
+    return ptr;
+}
+
+//' Describe a trace file
+//'
+//' @param trace is an external pointer to a trace file.
+//' @return a list with the number of parameters k, the number of values per
+//'         record, and the number of records written so far
+// [[Rcpp::export]]
+List tao_trace_info_cpp(SEXP trace) {
+    XPtr<TraceReader> reader(trace);
+    uint64_t records = reader_records(reader.get());
+    return List::create(
+        Named("k") = reader->header->k,
+        Named("width") = reader->header->width,
+        Named("records") = (double) records
+    );
+}
+
+//' Count the records of a trace file by type
+//'
+//' Only the type of each record is read from the mapped file.
+//'
+//' @param trace is an external pointer to a trace file.
+//' @return a list with the number of records of each type
+// [[Rcpp::export]]
+List tao_trace_types_cpp(SEXP trace) {
+    XPtr<TraceReader> reader(trace);
+    uint64_t records = reader_records(reader.get());
+    size_t record_size = 2 + reader->header->k + reader->header->width;
+    const double *record = trace_records(reader->header);
+    double counts[4] = {0, 0, 0, 0};
+    for (uint64_t r = 0; r < records; ++r) {
+        int kind = (int) record[r * record_size + 1];
+        if (kind >= TRACE_OBJECTIVE && kind <= TRACE_SEPARABLE) {
+            counts[kind] += 1;
+        }
+    }
+    return List::create(
+        Named(TYPE_NAMES[TRACE_OBJECTIVE]) = counts[TRACE_OBJECTIVE],
+        Named(TYPE_NAMES[TRACE_GRADIENT]) = counts[TRACE_GRADIENT],
+        Named(TYPE_NAMES[TRACE_HESSIAN]) = counts[TRACE_HESSIAN],
+        Named(TYPE_NAMES[TRACE_SEPARABLE]) = counts[TRACE_SEPARABLE]
+    );
+}
+
+//' Read records from a trace file
+//'
+//' Only the requested records are copied from the mapped file.
+//'
+//' @param trace is an external pointer to a trace file.
+//' @param records are the indices of the records, starting at 1.
+//' @return a list with the time of each evaluation in seconds since the solve
+//'         started, its type, and matrices with the parameters and the values
+// [[Rcpp::export]]
+List tao_trace_read_cpp(SEXP trace, IntegerVector records) {
+
+    XPtr<TraceReader> reader(trace);
+    uint64_t available = reader_records(reader.get());
+    int k = reader->header->k;
+    int width = reader->header->width;
+    int count = records.size();
+
+    NumericVector time(count);
+    CharacterVector type(count);
+    NumericMatrix x(count, k);
+    NumericMatrix values(count, width);
+    for (int r = 0; r < count; ++r) {
+        if (records[r] < 1 || (uint64_t) records[r] > available) {
+            stop("record " + std::to_string(records[r]) + " is not in the trace.");
+        }
+        const double *record = trace_records(reader->header) + (size_t) (records[r] - 1) * (2 + k + width);
+        time[r] = record[0];
+        int kind = (int) record[1];
+        type[r] = kind >= TRACE_OBJECTIVE && kind <= TRACE_SEPARABLE ? TYPE_NAMES[kind] : "unknown";
+        for (int i = 0; i < k; ++i) {
+            x(r, i) = record[2 + i];
+        }
+        for (int i = 0; i < width; ++i) {
+            values(r, i) = record[2 + k + i];
+        }
+    }
+
+    return List::create(
+        Named("time") = time,
+        Named("type") = type,
+        Named("x") = x,
+        Named("values") = values
+    );
+}
@@ -0,0 +1,69 @@
+#ifndef trace_h
+#define trace_h
+
+#include "taoR.h"
+#include <stdint.h>
+
+// Types of traced evaluations.
+enum {
+    TRACE_OBJECTIVE = 0,
+    TRACE_GRADIENT = 1,
+    TRACE_HESSIAN = 2,
+    TRACE_SEPARABLE = 3
+};
+
+// The header of a trace file. It is followed by fixed-size records of
+// 2 + k + width doubles: the time since the solve started, the type of the
+// evaluation, the parameters, and the values (the objective function value,
+// the gradient, or the residuals), padded with NaN. The writer increases
+// records after a record is complete, so readers in other processes see only
+// complete records.
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t k;
+    int32_t width;
+    int32_t reserved;
+    uint64_t records;
+} TraceHeader;
+
+// A trace file that grows by doubling its capacity.
+struct Trace {
+    int fd;
+    TraceHeader *header;
+    size_t capacity;
+    size_t record_size;
+    PetscLogDouble start;
+};
+
+// Creates a trace file, replacing an existing one.
+//
+// @param path The path of the file.
+// @param k The number of parameters.
+// @param n The number of residuals.
+// @returns The trace or NULL if the file cannot be created.
+Trace *trace_open(string path, int k, int n);
+
+// Appends an evaluation.
+//
+// @param trace The trace, may be NULL.
+// @param type The type of the evaluation.
+// @param X The parameters.
+// @param values The values, may be NULL.
+// @param count The number of values.
+// @returns Error code.
+PetscErrorCode trace_record(Trace *trace, int type, Vec X, const PetscReal *values, int count);
+
+// Appends an evaluation with values in a vector.
+PetscErrorCode trace_record(Trace *trace, int type, Vec X, Vec Y);
+
+// Truncates the file to its records and closes it.
+void trace_close(Trace *trace);
+
+// Checks the magic number and the version of a trace file.
+//
+// @param header The header of the file.
+// @returns Whether the file can be read.
+bool trace_valid(const TraceHeader *header);
+
+#endif
@@ -1,12 +1,27 @@
 #include <taoR.h>
+#include <mutex>
+#include <thread>
 #include "utils.h"
+#include "checkpoint.h"
+#include "progress.h"
+#include "budget.h"
+#include "history.h"
+#include "logging.h"
+#include "memory.h"
+#include "covariance.h"
+
+// the thread that runs R, output from other threads is deferred
+static std::thread::id r_thread = std::this_thread::get_id();
+static std::mutex output_lock;
+static string deferred_output;
 
 //' Initialize TAO
 //' 
 //' This function is called automatically when the package is loaded.
 // [[Rcpp::export]]
 void tao_init() {
-    initialize(Rcpp::List::create());
+    r_thread = std::this_thread::get_id();
+    initialize();
 }
 
 //' Finalize TAO
@@ -17,59 +32,29 @@ void tao_finalize() {
     PetscFinalize();
 }
 
-void initialize(Rcpp::List options) {
-    
-    int argc = 1 + 2 * options.size();
-    char** argv = new char*[argc];
-    
-    // Read in the name
-    string name = "\0";
-    argv[0] = new char[name.size() + 1];
-    strcpy(argv[0], name.c_str());
-    
-    if(options.size() > 0) {
-        
-        // Get the list of the column names
-        CharacterVector names = options.names();
-        
-        // internal counter
-        int counter = 1;
-        
-        // Read List into vector of char arrays
-        for (int i = 0; i < names.size(); ++i) {
-            string flag = "-" + names[i];
-            argv[counter] = new char[flag.size() + 1];
-            strcpy(argv[counter++], flag.c_str());
-            
-            string val = options[i];
-            argv[counter] = new char[val.size() + 1];
-            strcpy(argv[counter++], val.c_str());
-        }
-        
-    }
+void initialize() {
     
     // Check if already initialized
     PetscBool isInitialized;
     PetscInitialized(&isInitialized);
     
     if (isInitialized == PETSC_FALSE) {
-        // Initialize PETSc
+        // Initialize PETSc without command line arguments, the options of
+        // each solve are set by the solve itself
+        int argc = 1;
+        char name[] = "";
+        char *args[] = {name, NULL};
+        char **argv = args;
         PetscInitialize(&argc, &argv, (char *)0, (char *) 0);
-    } else { 
-        // Re-set the options
-        PetscOptionsClear(NULL);
-        PetscOptionsInsert(NULL, &argc, &argv, (char *) 0);
+        logging_register();
+        memory_register();
     }
-    
-    for(int i = 0; i < argc; ++i)
-        delete[] argv[i];
-    
-    delete[] argv;
 }
 
 // this function transforms a vector of type Vec to a vector of type
 // NumericVector
 NumericVector get_vec(Vec X, int k) {
+    LogEventScope log_event(TAOR_GetVec);
     PetscReal *x;
     VecGetArray(X, &x);
     NumericVector xVec(k);
@@ -83,21 +68,74 @@ NumericVector get_vec(Vec X, int k) {
 // this function reports the progress of the optimizer
 PetscErrorCode my_monitor(Tao tao_context, void *ptr) {
     
+    Problem *problem = (Problem *)ptr;
     PetscReal fc, gnorm;
     PetscInt its;
     PetscViewer viewer = PETSC_VIEWER_STDOUT_SELF;
+    LogEventScope log_event(TAOR_Monitor);
     
     PetscFunctionBegin;
     catch_error(TaoGetSolutionStatus(tao_context, &its, &fc, &gnorm, 0, 0, 0));
-    catch_error(PetscViewerASCIIPrintf(viewer, "iter = %3D,", its));
-    catch_error(PetscViewerASCIIPrintf(viewer, " Function value %g,", (double) fc));
-    if (gnorm > 1.e-6) {
-        catch_error(PetscViewerASCIIPrintf(viewer, " Residual: %g \n", (double) gnorm));
-    } else if (gnorm > 1.e-11) {
-        catch_error(PetscViewerASCIIPrintf(viewer, " Residual: < 1.0e-6 \n"));
-    } else {
-        catch_error(PetscViewerASCIIPrintf(viewer, " Residual: < 1.0e-11 \n"));
+    if (!problem->quiet) {
+        // one line per iteration is formatted in a single call
+        if (gnorm > 1.e-6) {
+            catch_error(PetscViewerASCIIPrintf(viewer, "iter = %3D, Function value %g, Residual: %g \n",
+                                               its, (double) fc, (double) gnorm));
+        } else if (gnorm > 1.e-11) {
+            catch_error(PetscViewerASCIIPrintf(viewer, "iter = %3D, Function value %g, Residual: < 1.0e-6 \n",
+                                               its, (double) fc));
+        } else {
+            catch_error(PetscViewerASCIIPrintf(viewer, "iter = %3D, Function value %g, Residual: < 1.0e-11 \n",
+                                               its, (double) fc));
+        }
+    }
+    
+    // Publish the progress and stop if the solve was cancelled
+    if (problem->progress != NULL) {
+        catch_error(progress_update(problem->progress, tao_context, problem->budget));
+        if (progress_cancelled(problem->progress)) {
+            catch_error(TaoSetConvergedReason(tao_context, TAO_DIVERGED_USER));
+        }
+    }
+    
+    // Record the convergence history
+    if (problem->history != NULL) {
+        catch_error(history_record(problem->history, tao_context, problem->budget->evaluations,
+                                   budget_elapsed(problem->budget)));
+    }
+    
+    // Remember the curvature along the path for the covariance
+    catch_error(covariance_record(problem->covariance, tao_context));
+    
+    // Stop once the time or evaluation budget is exhausted
+    catch_error(budget_check(problem->budget, tao_context));
+    
+    // Periodically write the checkpoint
+    if (problem->checkpoint != NULL && its % problem->checkpoint->every == 0) {
+        catch_error(checkpoint_write(problem->checkpoint, tao_context));
+    }
+    PetscFunctionReturn(0);
+}
+
+// Formats a message, retrying with a larger buffer if it does not fit
+static PetscErrorCode format_output(string &out, const char format[], va_list argp) {
+
+    char buff[1024];
+    size_t length;
+    va_list copy;
+
+    PetscFunctionBegin;
+    va_copy(copy, argp);
+    PetscErrorCode error_code = PetscVSNPrintf(buff, sizeof(buff), format, &length, copy);
+    va_end(copy);
+    CHKERRQ(error_code);
+    if (length < sizeof(buff)) {
+        out = buff;
+        PetscFunctionReturn(0);
     }
+    vector<char> large(length + 1);
+    catch_error(PetscVSNPrintf(&large[0], large.size(), format, &length, argp));
+    out = &large[0];
     PetscFunctionReturn(0);
 }
 
@@ -105,23 +143,37 @@ PetscErrorCode my_monitor(Tao tao_context, void *ptr) {
 // Overrides PetscVFPrintf.
 PetscErrorCode print_to_rcout(FILE *file, const char format[], va_list argp) {
         
+    string buff;
+
     PetscFunctionBegin;
     if (file != stdout && file != stderr) {
         catch_error(PetscVFPrintfDefault(file, format, argp));
+    } else if (!on_r_thread()) {
+        catch_error(format_output(buff, format, argp));
+        std::lock_guard<std::mutex> guard(output_lock);
+        deferred_output += buff;
     } else if (file == stdout) {
-        char buff[1024];
-        size_t length;
-        catch_error(PetscVSNPrintf(buff, 1024, format, &length, argp));
+        catch_error(format_output(buff, format, argp));
         Rcout << buff;
     } else if (file == stderr) {
-        char buff[1024];
-        size_t length;
-        catch_error(PetscVSNPrintf(buff, 1024, format, &length, argp));
+        catch_error(format_output(buff, format, argp));
         Rcerr << buff;
     }
     PetscFunctionReturn(0);
 }
 
+bool on_r_thread() {
+    return std::this_thread::get_id() == r_thread;
+}
+
+void flush_output() {
+    std::lock_guard<std::mutex> guard(output_lock);
+    if (!deferred_output.empty()) {
+        Rcout << deferred_output;
+        deferred_output.clear();
+    }
+}
+
 PetscErrorCode evaluate_function(Vec X, PetscReal *y, Function *f, int k) {
     
     PetscReal *x;
@@ -132,6 +184,7 @@ PetscErrorCode evaluate_function(Vec X, PetscReal *y, Function *f, int k) {
     catch_error(VecGetArray(X, &x));
 
     // Write into Rcpp vector and evaluate
+    LogEventScope log_event(TAOR_CallR);
     NumericVector xVec = get_vec(X, k);
     NumericVector yVec = (*f)(xVec);
     
@@ -158,6 +211,7 @@ PetscErrorCode evaluate_function(Vec X, Vec Y, Function *f, int k, int n) {
     catch_error(VecGetArray(Y, &y));
     
     // Write into Rcpp vector and evaluate
+    LogEventScope log_event(TAOR_CallR);
     NumericVector xVec = get_vec(X, k);
     NumericVector yVec = (*f)(xVec);
     
@@ -187,10 +241,15 @@ PetscErrorCode evaluate_function(Vec X, Mat Y, Function *f, int k, int n) {
     catch_error(VecGetArray(X, &x));
 
     // Write into Rcpp vector and evaluate
-    NumericVector xVec = get_vec(X, k);
-    NumericMatrix yMat = (*f)(xVec);
+    NumericMatrix yMat;
+    {
+        LogEventScope log_event(TAOR_CallR);
+        NumericVector xVec = get_vec(X, k);
+        yMat = (*f)(xVec);
+    }
     
     // Assemble the matrix
+    LogEventScope log_event(TAOR_Assembly);
     for (int row = 0; row < n; ++row) {
         for (int col = 0; col < n; ++col) {
             MatSetValues(Y, 1, &row, 1, &col, &(yMat(row, col)), INSERT_VALUES);
@@ -203,3 +262,81 @@ PetscErrorCode evaluate_function(Vec X, Mat Y, Function *f, int k, int n) {
     PetscFunctionReturn(0);
   
 }
+
+PetscErrorCode evaluate_native(Vec X, PetscReal *y, NativeObjective f, void *data, int k) {
+    
+    const PetscReal *x;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    {
+        LogEventScope log_event(TAOR_CallNative);
+        catch_error(f(k, x, y, data));
+    }
+    catch_error(VecRestoreArrayRead(X, &x));
+    PetscFunctionReturn(0);
+    
+}
+
+PetscErrorCode evaluate_native(Vec X, Vec Y, NativeVector f, void *data, int k, int n) {
+    
+    const PetscReal *x;
+    PetscReal *y;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    catch_error(VecGetArray(Y, &y));
+    {
+        LogEventScope log_event(TAOR_CallNative);
+        catch_error(f(k, x, n, y, data));
+    }
+    catch_error(VecRestoreArrayRead(X, &x));
+    catch_error(VecRestoreArray(Y, &y));
+    PetscFunctionReturn(0);
+    
+}
+
+PetscErrorCode evaluate_native(Vec X, PetscReal *y, Vec G, NativeObjectiveGradient f, void *data, int k) {
+    
+    const PetscReal *x;
+    PetscReal *g;
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    catch_error(VecGetArray(G, &g));
+    {
+        LogEventScope log_event(TAOR_CallNative);
+        catch_error(f(k, x, y, g, data));
+    }
+    catch_error(VecRestoreArrayRead(X, &x));
+    catch_error(VecRestoreArray(G, &g));
+    PetscFunctionReturn(0);
+    
+}
+
+PetscErrorCode evaluate_native(Vec X, Mat Y, NativeVector f, void *data, int k) {
+    
+    const PetscReal *x;
+    vector<PetscReal> y(k * k);
+    vector<PetscInt> index(k);
+    
+    PetscFunctionBegin;
+    catch_error(VecGetArrayRead(X, &x));
+    {
+        LogEventScope log_event(TAOR_CallNative);
+        catch_error(f(k, x, k * k, &y[0], data));
+    }
+    catch_error(VecRestoreArrayRead(X, &x));
+    
+    // Assemble the matrix, column by column
+    LogEventScope log_event(TAOR_Assembly);
+    for (int i = 0; i < k; ++i) {
+        index[i] = i;
+    }
+    catch_error(MatSetOption(Y, MAT_ROW_ORIENTED, PETSC_FALSE));
+    catch_error(MatSetValues(Y, k, &index[0], k, &index[0], &y[0], INSERT_VALUES));
+    catch_error(MatAssemblyBegin(Y, MAT_FINAL_ASSEMBLY));
+    catch_error(MatAssemblyEnd(Y, MAT_FINAL_ASSEMBLY));
+    PetscFunctionReturn(0);
+    
+}
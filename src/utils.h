@@ -3,11 +3,9 @@
 
 #include "taoR.h"
 
-// Initializes petsc. Wraps messy command line parsing. Call me but once.
-//
-// @param options is the list to read. The column names are the flags, the values are
-//        passed in as strings.
-void initialize(List options);
+// Initializes petsc unless it is already initialized. Options are set per
+// solve, see options.h.
+void initialize();
 
 // Returns the values of a Petsc vector written into an Rcpp vector.
 //
@@ -23,9 +21,17 @@ NumericVector get_vec(Vec X, int k);
 // @returns Error code checked with catch_error.
 PetscErrorCode my_monitor(Tao tao_context, void *ptr);
 
-// Re-directs all Petsc output from stdout to Rcpp:Rcout.
+// Re-directs all Petsc output from stdout to Rcpp:Rcout. Output from other
+// threads than the R thread is deferred until flush_output is called.
 PetscErrorCode print_to_rcout(FILE *file, const char format[], va_list argp);
 
+// Prints the output that was deferred by print_to_rcout. Call me only from
+// the R thread.
+void flush_output();
+
+// Whether the caller runs on the R thread and may call into R.
+bool on_r_thread();
+
 // Evaluates an Rcpp function of the form f(X).
 //
 // @param X Vector to evalute function on.
@@ -66,4 +72,41 @@ PetscErrorCode evaluate_function(Vec X, Mat Y, Function *f, int k);
 // @returns Error code checked with catch_error.
 PetscErrorCode evaluate_function(Vec X, Mat Y, Function *f, int k, int n);
 
+// Evaluates a native function of the form f(X).
+//
+// @param X Vector to evalute function on.
+// @param y Stores the result of the function.
+// @param f The function to evaluate.
+// @param data The data of the native objective.
+// @returns Error code checked with catch_error.
+PetscErrorCode evaluate_native(Vec X, PetscReal *y, NativeObjective f, void *data, int k);
+
+// Evaluates a native function which maps R^k to R^n.
+//
+// @param X k-vector to evalute function on.
+// @param Y n-vector to store result.
+// @param f The function to evaluate.
+// @param data The data of the native objective.
+// @returns Error code checked with catch_error.
+PetscErrorCode evaluate_native(Vec X, Vec Y, NativeVector f, void *data, int k, int n);
+
+// Evaluates a native function and its gradient in one pass.
+//
+// @param X Vector to evalute function on.
+// @param y Stores the result of the function.
+// @param G k-vector to store the gradient.
+// @param f The function to evaluate.
+// @param data The data of the native objective.
+// @returns Error code checked with catch_error.
+PetscErrorCode evaluate_native(Vec X, PetscReal *y, Vec G, NativeObjectiveGradient f, void *data, int k);
+
+// Evaluates a native function which maps R^k to R^(k^2).
+//
+// @param X k-vector to evalute function on.
+// @param Y kxk matrix to store result.
+// @param f The function to evaluate. Writes a kxk matrix in column-major order.
+// @param data The data of the native objective.
+// @returns Error code checked with catch_error.
+PetscErrorCode evaluate_native(Vec X, Mat Y, NativeVector f, void *data, int k);
+
 #endif